@@ -1,6 +1,50 @@
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <csignal>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <deque>
+#include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
 using namespace std;
 
 // R=River, C=Cabbage, G=Goat, W=Wolf
@@ -27,69 +71,117 @@ using namespace std;
 #define PCWRG    0xD2
 
 
+typedef unsigned long long State;    // encoded problem state
+typedef unsigned long long Action;   // encoded action
+
+class StateRanking;
+
+
 class Problem
 {
     protected:
-    short initial,            // initial state of the problem
-           goal;            // goal state of the problem
+    State initial,            // initial state of the problem
+          goal;               // goal state of the problem
     public:
 
     // specifies initial state, and optionally a goal state.
     // child class can specify additional goal state(s)
-    Problem(short initial, short goal = 0)
+    Problem(State initial, State goal = 0)
     {
         this->initial = initial;
         this->goal = goal;
     }
+    virtual ~Problem() {}
 
     // returns a list of actions that can be executed by a specified state.
-    virtual deque<short> actions(short) = 0;
+    virtual deque<Action> actions(State) = 0;
 
     // returns the state that results from a given state and given action
-    virtual short result(short, short) = 0;
+    virtual State result(State, Action) = 0;
+
+    // maps a state to the representative of its symmetry class. states of
+    // one class must have the same goal_test() answer and mirror each
+    // other's moves, so a search only needs to visit one of them.
+    virtual State canonical(State s) const { return s; }
+
+    // true if canonical() merges any states.
+    virtual bool hasSymmetry() const { return false; }
+
+    // returns a dense numbering of the problem's canonical states. the
+    // default enumerates the states reachable from the initial state.
+    virtual unique_ptr<StateRanking> ranking();
+
+    // returns an upper bound on the number of actions of any state, or 0
+    // if unknown.
+    virtual size_t maxActions() const { return 0; }
+
+    // true if every action can be undone by an action of the state it
+    // leads to, so paths can be walked backwards from the goal.
+    virtual bool reversible() const { return false; }
+
+    // returns the cost of taking an action in a state. only the astar and
+    // dijkstra engines weigh actions; the others count them.
+    virtual size_t cost(State, Action) const { return 1; }
+
+    // returns a lower bound on the cost of reaching the goal from a state.
+    // it must never overestimate, and should fall by no more than the cost
+    // of an action. the default of 0 turns A* into a uniform cost search.
+    virtual size_t heuristic(State) const { return 0; }
+
+    // returns a hash of the rules, the same for every problem with the
+    // same actions(), result() and cost(), whatever its endpoints. 0 means
+    // the rules are not identified, so results are never cached.
+    virtual uint64_t fingerprint() const { return 0; }
 
     // returns true if given state is the goal state.
-    bool goal_test(short g) const
+    bool goal_test(State g) const
     {
         return goal == g;    }
+
+    State getInitial() const { return initial; }
+    State getGoal() const { return goal; }
 };
 
 
 class Node
 {
     private:
-    short state;       // the state represented by this node
-    short action;      // the action taken by the parent to get here
+    State state;       // the state represented by this node
+    Action action;     // the action taken by the parent to get here
     Node* parent;       // a pointer to the node that generated this one
-    deque<short> soln;
+    deque<Action> soln;
     public:
 
     // initializes the Node with a given state, the action that got us to this
     // state, and the pointer to a parent Node.
-    Node(short, short = 0, Node* = nullptr);
+    Node(State, Action = 0, Node* = nullptr);
     // returns a list of dynamically created nodes that are children of
     // a node with the given state.
-    deque<Node*> expand(Problem*, short);
+    deque<Node*> expand(Problem*, State);
     // generates a child node with a state given an action.
-    Node* childNode(Problem*, short);
+    Node* childNode(Problem*, Action);
     // returns a list of the actions taken to get from root to here
-    deque<short> solution();
+    deque<Action> solution();
     // returns a list of the nodes in the path from root to here
     deque<Node*> path();
 
-    short getState() const { return state; }
+    State getState() const { return state; }
 };
 
-Node::Node(short s, short a, Node* p)
+Node::Node(State s, Action a, Node* p)
 {
     state = s;
     action = a;
+    parent = p;
+    // the root has no incoming action, so its solution stays empty
     if(p)
+    {
         soln = p->solution();
-    soln.push_back(a);
+        soln.push_back(a);
+    }
 }
 
-deque<short> Node::solution()
+deque<Action> Node::solution()
 {
     return soln;
 }
@@ -97,21 +189,21 @@ deque<short> Node::solution()
 class BFSProblem : public Problem
 {
     public:
-    BFSProblem(short initial, short goal = 0) : Problem(initial, goal) {}
+    BFSProblem(State initial, State goal = 0) : Problem(initial, goal) {}
 
-    virtual deque<short> actions(short);
-    virtual short result(short, short);
-
-    short getInitial() const;
-    short getGoal() const { return goal; }
+    virtual deque<Action> actions(State);
+    virtual State result(State, Action);
+    virtual size_t maxActions() const { return 3; }
+    virtual bool reversible() const { return true; }
+    virtual uint64_t fingerprint() const { return 1; }
 };
 
 // action encoding:
 // 1100 0000 = 192 = PC cross to the left
 // 0000 1001 = 9 = PW cross to the right.
-deque<short> BFSProblem::actions(short state)
+deque<Action> BFSProblem::actions(State state)
 {
-    deque<short> acts;
+    deque<Action> acts;
 
     if(state == RPCGW)
         acts.push_back(LP|LG);
@@ -157,10 +249,12 @@ deque<short> BFSProblem::actions(short state)
         acts.push_back(RP|RG);
         acts.push_back(RP|RW);
     }
+    else if(state == PCGWR)
+        acts.push_back(RP|RG);
     return acts;
 }
 
-short BFSProblem::result(short state, short action)
+State BFSProblem::result(State state, Action action)
 {
     if(action == LP)
         state = state & ~RP | LP;
@@ -182,100 +276,6145 @@ short BFSProblem::result(short state, short action)
     return state;
 }
 
-// helper function
-short BFSProblem::getInitial() const
-{ return initial; }
+// generalized river crossing: the peasant ferries named items across,
+// taking at most capacity of them per trip, and may never leave an item
+// on a bank with something that eats it. items sharing a name are
+// interchangeable.
+//
+// state encoding: bit i set = item i on the right bank, bit n = peasant
+// on the right bank. an action is the mask of the bits the crossing
+// flips, so result(s, a) = s ^ a.
+//
+// with symmetry enabled, canonical() sorts each group of interchangeable
+// items so the ones on the right bank come first. mirroring the banks is
+// not used: it maps the initial state onto the goal, so it is not a
+// symmetry of a search between the two.
+class CrossingProblem : public Problem
+{
+    private:
+    vector<string> names;          // item names, one entry per item
+    vector<State> eats;            // eats[i]: mask of items item i eats
+    vector<size_t> weight;         // weight[i]: cost of a crossing with item i
+    vector<State> groupMask;       // items of each interchangeable group
+    vector<vector<State>> groupFill; // groupFill[g][k]: first k items of group g
+    State items,                   // mask of all item bits
+          peasant,                 // the peasant's bit
+          grouped;                 // union of groupMask
+    int capacity;                  // items carried per trip
+    bool symmetry;                 // canonical() merges interchangeable items
+
+    friend class CrossingRanking;
+
+    bool safe(State) const;
+    void addLoads(deque<Action>&, State, State, int, int) const;
+    public:
+
+    // names lists every item, eaten pairs (predator, prey) by name.
+    CrossingProblem(const vector<string>& names,
+                    const vector<pair<string, string>>& eaten,
+                    int capacity = 1, bool symmetry = false);
+
+    virtual deque<Action> actions(State);
+    virtual State result(State, Action);
+    virtual State canonical(State) const;
+    virtual bool hasSymmetry() const { return symmetry && grouped; }
+    virtual unique_ptr<StateRanking> ranking();
+    virtual size_t maxActions() const;
+    virtual bool reversible() const { return true; }
+    virtual size_t cost(State, Action) const;
+    virtual size_t heuristic(State) const;
+    virtual uint64_t fingerprint() const;
+
+    // sets the cost of a crossing carrying the items of a name.
+    void setWeight(const string&, size_t);
+    // returns the number of states merged into each canonical state.
+    double symmetryOrder() const;
+    // describes an action taken in a state, e.g. "Peasant and goat crosses right."
+    string describe(State, Action) const;
+};
+
+CrossingProblem::CrossingProblem(const vector<string>& names,
+                                 const vector<pair<string, string>>& eaten,
+                                 int capacity, bool symmetry)
+    : Problem(0, (State(2) << names.size()) - 1), names(names),
+      eats(names.size(), 0), weight(names.size(), 1), capacity(capacity),
+      symmetry(symmetry)
+{
+    peasant = State(1) << names.size();
+    items = peasant - 1;
+    grouped = 0;
+
+    for(const pair<string, string>& e : eaten)
+        for(size_t i = 0; i < names.size(); i++)
+            for(size_t j = 0; j < names.size(); j++)
+                if(names[i] == e.first && names[j] == e.second)
+                    eats[i] |= State(1) << j;
+
+    // items with the same name form a group, in first appearance order
+    vector<bool> done(names.size(), false);
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        if(done[i])
+            continue;
+        State mask = 0;
+        vector<State> fill(1, 0);
+        for(size_t j = i; j < names.size(); j++)
+            if(names[j] == names[i])
+            {
+                done[j] = true;
+                mask |= State(1) << j;
+                fill.push_back(mask);
+            }
+        if(fill.size() > 2)
+        {
+            groupMask.push_back(mask);
+            groupFill.push_back(fill);
+            grouped |= mask;
+        }
+    }
+}
+
+// true if no item is left with something that eats it.
+bool CrossingProblem::safe(State s) const
+{
+    State alone = (s & peasant) ? ~s & items : s & items;
+    for(State rest = alone; rest; rest &= rest - 1)
+        if(eats[__builtin_ctzll(rest)] & alone)
+            return false;
+    return true;
+}
+
+// appends every safe trip carrying load plus up to left more items from
+// the bits of avail at or above position from.
+void CrossingProblem::addLoads(deque<Action>& acts, State s, State load,
+                               int left, int from) const
+{
+    Action a = load | peasant;
+    if(safe(s ^ a))
+        acts.push_back(a);
+    if(left == 0)
+        return;
+    State avail = ((s & peasant) ? s : ~s) & items & ~((State(1) << from) - 1);
+    for(; avail; avail &= avail - 1)
+    {
+        int i = __builtin_ctzll(avail);
+        addLoads(acts, s, load | State(1) << i, left - 1, i + 1);
+    }
+}
+
+deque<Action> CrossingProblem::actions(State state)
+{
+    deque<Action> acts;
+    addLoads(acts, state, 0, capacity, 0);
+    return acts;
+}
+
+State CrossingProblem::result(State state, Action action)
+{
+    return state ^ action;
+}
+
+State CrossingProblem::canonical(State s) const
+{
+    if(!symmetry)
+        return s;
+    State c = s & ~grouped;
+    for(size_t g = 0; g < groupMask.size(); g++)
+        c |= groupFill[g][__builtin_popcountll(s & groupMask[g])];
+    return c;
+}
+
+size_t CrossingProblem::maxActions() const
+{
+    // one trip per load of at most capacity items
+    size_t total = 0, loads = 1;
+    for(int k = 0; k <= capacity && k <= int(names.size()); k++)
+    {
+        total += loads;
+        loads = loads * (names.size() - k) / (k + 1);
+    }
+    return total;
+}
+
+// a crossing takes as long as its slowest passenger. the peasant alone,
+// and items without a weight, take 1.
+size_t CrossingProblem::cost(State, Action action) const
+{
+    size_t c = 1;
+    for(State rest = action & items; rest; rest &= rest - 1)
+        c = max(c, weight[__builtin_ctzll(rest)]);
+    return c;
+}
+
+void CrossingProblem::setWeight(const string& name, size_t w)
+{
+    for(size_t i = 0; i < names.size(); i++)
+        if(names[i] == name)
+            weight[i] = w;
+}
+
+// every item still on the left needs a trip right, at most capacity to a
+// trip, and the peasant must come back between trips. each crossing moves
+// at most capacity items and costs at least 1, so the bound falls by no
+// more than the cost of an action.
+size_t CrossingProblem::heuristic(State s) const
+{
+    size_t left = __builtin_popcountll(~s & items),
+           trips = (left + capacity - 1) / capacity;
+    if(s & peasant)
+        return 2 * trips;
+    return trips ? 2 * trips - 1 : 1;
+}
+
+// FNV-1a over the item names, what each eats, the weights and the
+// capacity. symmetry only changes how states are searched, not the rules.
+uint64_t CrossingProblem::fingerprint() const
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&h](uint64_t v) { h = (h ^ v) * 0x100000001b3ull; };
+    add(names.size());
+    add(capacity);
+    for(size_t i = 0; i < names.size(); i++)
+    {
+        add(names[i].size());
+        for(char c : names[i])
+            add((unsigned char)c);
+        add(eats[i]);
+        add(weight[i]);
+    }
+    return h ? h : 2;
+}
+
+double CrossingProblem::symmetryOrder() const
+{
+    double order = 1;
+    if(symmetry)
+        for(const vector<State>& fill : groupFill)
+            for(size_t k = 2; k < fill.size(); k++)
+                order *= k;
+    return order;
+}
+
+string CrossingProblem::describe(State state, Action action) const
+{
+    vector<string> carried;
+    for(State rest = action & items; rest; rest &= rest - 1)
+        carried.push_back(names[__builtin_ctzll(rest)]);
+
+    string text = "Peasant";
+    for(size_t i = 0; i < carried.size(); i++)
+        text += (i + 1 == carried.size() ? " and " : ", ") + carried[i];
+    text += (state & peasant) ? " crosses left." : " crosses right.";
+    return text;
+}
 
 // function for expanding a child node
-Node* childNode(Problem* prob, Node* parent, short action)
+Node* childNode(Problem* prob, Node* parent, Action action)
 {
     return new Node(prob->result(parent->getState(), action), action, parent);
 }
 
-// BFS implementation, returns a list of actions as the solution
-deque<short> BFS(BFSProblem* p)
+// mixes the bits of a state so that every output bit depends on every
+// input bit (the murmur3 finalizer).
+struct StateHash
+{
+    size_t operator()(State s) const
+    {
+        s ^= s >> 33;
+        s *= 0xff51afd7ed558ccdull;
+        s ^= s >> 33;
+        s *= 0xc4ceb9fe1a85ec53ull;
+        s ^= s >> 33;
+        return s;
+    }
+};
+
+// an open addressing hash set for keys that are only ever inserted. slots
+// come in groups of 16 with one control byte each: EMPTY, or the low 7
+// bits of the key's hash. a lookup compares a whole group's control bytes
+// at once (with SSE2 where available) and only looks at the keys whose
+// bytes match, moving on to the next group while the group is full. the
+// table doubles at 7/8 load. Key needs ==, Hash must mix well in all bits.
+template<class Key, class Hash = StateHash>
+class FlatHashSet
+{
+    private:
+    static constexpr size_t GROUP = 16;
+    static constexpr uint8_t EMPTY = 0x80;
+
+    vector<uint8_t> ctrl;          // control byte of each slot
+    vector<Key> slots;             // the keys, valid where ctrl is not EMPTY
+    size_t count,                  // number of keys
+           groupMask;              // number of groups - 1, a power of 2 less 1
+    Hash hash;
+
+    // bit i set where the group's control byte i equals b.
+    static uint32_t match(const uint8_t* group, uint8_t b)
+    {
+#ifdef __SSE2__
+        __m128i g = _mm_loadu_si128((const __m128i*)group);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(b)));
+#else
+        uint32_t bits = 0;
+        for(size_t i = 0; i < GROUP; i++)
+            bits |= uint32_t(group[i] == b) << i;
+        return bits;
+#endif
+    }
+
+    // finds key, returning its slot, or the empty slot it would go to
+    // and setting free.
+    size_t find(const Key& key, size_t h, bool& free) const
+    {
+        uint8_t tag = h & 0x7F;
+        for(size_t g = (h >> 7) & groupMask; ; g = (g + 1) & groupMask)
+        {
+            const uint8_t* group = &ctrl[g * GROUP];
+            for(uint32_t m = match(group, tag); m; m &= m - 1)
+                if(slots[g * GROUP + __builtin_ctz(m)] == key)
+                {
+                    free = false;
+                    return g * GROUP + __builtin_ctz(m);
+                }
+            uint32_t empty = match(group, EMPTY);
+            if(empty)
+            {
+                free = true;
+                return g * GROUP + __builtin_ctz(empty);
+            }
+        }
+    }
+
+    void grow()
+    {
+        vector<uint8_t> oldCtrl(2 * ctrl.size(), EMPTY);
+        vector<Key> oldSlots(2 * slots.size());
+        oldCtrl.swap(ctrl);
+        oldSlots.swap(slots);
+        groupMask = groupMask * 2 + 1;
+        for(size_t i = 0; i < oldSlots.size(); i++)
+            if(oldCtrl[i] != EMPTY)
+            {
+                size_t h = hash(oldSlots[i]);
+                bool free;
+                size_t at = find(oldSlots[i], h, free);
+                ctrl[at] = h & 0x7F;
+                slots[at] = oldSlots[i];
+            }
+    }
+    public:
+
+    // sizes the table for the expected number of keys.
+    FlatHashSet(size_t expected = 0) : count(0), groupMask(0)
+    {
+        while((groupMask + 1) * GROUP * 7 / 8 < expected)
+            groupMask = groupMask * 2 + 1;
+        ctrl.assign((groupMask + 1) * GROUP, EMPTY);
+        slots.resize((groupMask + 1) * GROUP);
+    }
+
+    // adds key if absent. returns true if it was added.
+    bool insert(const Key& key)
+    {
+        if(count + 1 > slots.size() * 7 / 8)
+            grow();
+        size_t h = hash(key);
+        bool free;
+        size_t at = find(key, h, free);
+        if(!free)
+            return false;
+        ctrl[at] = h & 0x7F;
+        slots[at] = key;
+        count++;
+        return true;
+    }
+
+    bool contains(const Key& key) const
+    {
+        bool free;
+        find(key, hash(key), free);
+        return !free;
+    }
+
+    // removes every key but keeps the table's size.
+    void clear()
+    {
+        fill(ctrl.begin(), ctrl.end(), EMPTY);
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    size_t bytes() const { return ctrl.size() + slots.size() * sizeof(Key); }
+};
+
+// a hash set of states that many threads can insert into at once. keys
+// are spread over independently sized shards; within a shard, inserts
+// claim slots of a linear probing table with compare-and-swap, holding
+// the shard's lock only in shared mode. the thread whose insert takes a
+// shard past half full grows that shard under its exclusive lock, so
+// growth work falls to the inserting threads and stalls one shard at a
+// time. state 0 marks an empty slot and is tracked by a separate flag.
+class ConcurrentStateSet
+{
+    private:
+    struct alignas(64) Shard
+    {
+        shared_mutex guard;        // shared for inserts, exclusive to grow
+        unique_ptr<atomic<State>[]> slots;
+        size_t capacity;           // number of slots, a power of 2
+        atomic<size_t> count;      // keys in the shard
+    };
+
+    vector<Shard> shards;
+    size_t shardMask;              // number of shards - 1
+    int shardBits;                 // hash bits used to pick the shard
+    atomic<bool> hasZero;          // state 0 is in the set
+    StateHash hash;
+
+    static void allocate(Shard& sh, size_t capacity)
+    {
+        sh.slots.reset(new atomic<State>[capacity]);
+        for(size_t i = 0; i < capacity; i++)
+            sh.slots[i].store(0, memory_order_relaxed);
+        sh.capacity = capacity;
+    }
+
+    // doubles the shard unless another thread already grew it past seen.
+    void grow(Shard& sh, size_t seen)
+    {
+        unique_lock<shared_mutex> hold(sh.guard);
+        if(sh.capacity != seen)
+            return;
+        unique_ptr<atomic<State>[]> old = move(sh.slots);
+        allocate(sh, seen * 2);
+        for(size_t i = 0; i < seen; i++)
+        {
+            State k = old[i].load(memory_order_relaxed);
+            if(!k)
+                continue;
+            size_t at = (hash(k) >> shardBits) & (sh.capacity - 1);
+            while(sh.slots[at].load(memory_order_relaxed))
+                at = (at + 1) & (sh.capacity - 1);
+            sh.slots[at].store(k, memory_order_relaxed);
+        }
+    }
+    public:
+
+    // sizes the shards for the expected number of keys.
+    ConcurrentStateSet(size_t expected = 0, size_t shardCount = 64)
+        : shards(shardCount), shardMask(shardCount - 1), shardBits(0), hasZero(false)
+    {
+        while((size_t(1) << shardBits) < shardCount)
+            shardBits++;
+        size_t per = 16;
+        while(per * shardCount < expected * 2)
+            per *= 2;
+        for(Shard& sh : shards)
+        {
+            allocate(sh, per);
+            sh.count.store(0);
+        }
+    }
+
+    // adds s if absent. returns true if this call added it.
+    bool insert(State s)
+    {
+        if(s == 0)
+            return !hasZero.exchange(true);
+        size_t h = hash(s);
+        Shard& sh = shards[h & shardMask];
+        for(;;)
+        {
+            size_t seen, added = 0;
+            {
+                shared_lock<shared_mutex> hold(sh.guard);
+                seen = sh.capacity;
+                size_t mask = seen - 1, at = (h >> shardBits) & mask;
+                for(size_t probes = 0; probes < seen; probes++, at = (at + 1) & mask)
+                {
+                    State cur = sh.slots[at].load(memory_order_acquire);
+                    if(cur == s)
+                        return false;
+                    if(cur == 0)
+                    {
+                        if(sh.slots[at].compare_exchange_strong(cur, s))
+                        {
+                            added = sh.count.fetch_add(1) + 1;
+                            break;
+                        }
+                        if(cur == s)
+                            return false;
+                    }
+                }
+            }
+            // a full shard retries after growing
+            if(added == 0 || added > seen / 2)
+                grow(sh, seen);
+            if(added)
+                return true;
+        }
+    }
+
+    size_t size() const
+    {
+        size_t n = hasZero.load();
+        for(const Shard& sh : shards)
+            n += sh.count.load();
+        return n;
+    }
+
+    size_t bytes() const
+    {
+        size_t n = shards.size() * sizeof(Shard);
+        for(const Shard& sh : shards)
+            n += sh.capacity * sizeof(State);
+        return n;
+    }
+};
+
+// how a search ended
+enum SearchStatus
+{
+    Running,                       // not finished yet
+    Solved,                        // reached the goal
+    Unsolvable,                    // ran out of states first
+    OverBudget,                    // hit a node, depth or time limit first
+    Cancelled,                     // stopped through its cancel flag
+    Failed                         // could not go on, e.g. on an I/O error
+};
+
+// counters filled in by a search
+struct SearchStats
+{
+    size_t expanded = 0,       // states whose actions were applied
+           generated = 0,      // child states produced
+           stored = 0,         // distinct (canonical) states reached
+           ranked = 0,         // size of the dense state numbering, if used
+           bytes = 0,          // peak bytes of per-state tables, if tracked
+           diskBytes = 0,      // bytes written to disk, if any
+           spills = 0,         // levels moved to disk
+           failedSpills = 0,   // levels that could not be moved to disk
+           reloads = 0;        // spilled levels read back
+    double omitted = 0;        // expected states a probabilistic search missed
+    SearchStatus status = Running; // how the search ended, if tracked
+};
+
+// bounds on a BFS() or SteppingSearch. the cancel flag and the clock are
+// sampled every checkEvery expansions only, so watching them costs next to
+// nothing against the expansions themselves. a checkEvery of 0 samples
+// on every expansion.
+struct SearchLimits
+{
+    const atomic<bool>* cancel = nullptr;   // stop once this is set
+    size_t maxExpanded = SIZE_MAX,          // expansions allowed
+           maxDepth = SIZE_MAX,             // longest solution looked for
+           checkEvery = 256;                // expansions between samples
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+};
+
+// returns how a search that has made expanded expansions and is about to
+// expand a state at depth stands against its limits: Running, OverBudget
+// or Cancelled.
+static SearchStatus checkLimits(const SearchLimits& limits, size_t expanded, size_t depth)
+{
+    if(expanded >= limits.maxExpanded || depth >= limits.maxDepth)
+        return OverBudget;
+    if(expanded % max(size_t(1), limits.checkEvery) == 0)
+    {
+        if(limits.cancel && limits.cancel->load(memory_order_relaxed))
+            return Cancelled;
+        if(limits.deadline != chrono::steady_clock::time_point::max()
+           && chrono::steady_clock::now() >= limits.deadline)
+            return OverBudget;
+    }
+    return Running;
+}
+
+// BFS implementation, returns a list of actions as the solution.
+// states are deduplicated by their canonical() representative, but nodes
+// keep the concrete state they were reached in, so the actions along a
+// node's solution apply as-is and never need mapping back. a search
+// stopped by its limits returns no actions, with the reason in
+// stats->status.
+deque<Action> BFS(Problem* p, SearchStats* stats = nullptr,
+                  const SearchLimits& limits = SearchLimits())
 {
     deque<Node*> frontier,  // all child nodes of a node
         expanded;            // tracks all the nodes that got created.
-    deque<short> solution,     // the sequence of actions to get to goal state
-                explored;    // the list of explored states
+    deque<Action> solution;  // the sequence of actions to get to goal state
+    FlatHashSet<State> explored;   // canonical states already reached
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
 
     Node* node = new Node(p->getInitial());
     frontier.push_back( node );
     expanded.push_back( node );
+    explored.insert(p->canonical(node->getState()));
 
     if(p->goal_test(node->getState()))
-        solution = node->solution();
+        frontier.clear();
 
+    size_t depth = 0,              // depth of the front node
+           left = 1,               // nodes of that depth still queued
+           queued = 0;             // nodes of the next depth queued
     while(!frontier.empty())
     {
+        if(left == 0)
+        {
+            depth++;
+            left = queued;
+            queued = 0;
+        }
+        SearchStatus status = checkLimits(limits, st.expanded, depth);
+        if(status != Running)
+        {
+            st.status = status;
+            frontier.clear();
+            break;
+        }
         node = frontier.front();
         frontier.pop_front();
+        left--;
+        st.expanded++;
 
-        explored.push_back(node->getState());
-
-        for(short action : p->actions(node->getState()))
+        for(Action action : p->actions(node->getState()))
         {
             Node* child = childNode(p, node, action);
             expanded.push_back(child);
+            st.generated++;
 
-            if(find(frontier.begin(), frontier.end(), child) == frontier.end()
-                && find(explored.begin(), explored.end(), child->getState()) == explored.end())
+            State key = p->canonical(child->getState());
+            if(explored.insert(key))
             {
                 if(p->goal_test(child->getState()))
                 {
+                    solution = child->solution();
+                    st.stored = explored.size();
+
                     // free memory
                     for(Node* n : expanded)
                         delete n;
 
-                    return child->solution();
+                    return solution;
                 }
 
                 frontier.push_back(child);
+                queued++;
             }
         }
     }
+    st.stored = explored.size();
+
+    for(Node* n : expanded)
+        delete n;
 
     return solution;
 }
 
-int main()
-{                                  //start, goal
-    BFSProblem* b = new BFSProblem(RPCGW, PCGWR);
+// breadth first search that runs in steps, so a caller can interleave
+// many searches on one thread, stop at a deadline and carry on later
+// without losing work. states are expanded and goal tested in the order
+// BFS() uses, and each level is kept as (state, action, parent index)
+// records like parallelBFS(), so the path found is the one BFS() returns.
+// a search over its limits stops for good, keeping its statistics.
+// reset() starts another search in the same object, reusing its tables.
+class SteppingSearch
+{
+    private:
+    struct Record
+    {
+        State state;               // concrete state reached
+        Action action;             // action that reached it
+        size_t parent;             // index of the parent in the level above
+    };
+
+    Problem* prob;
+    SearchLimits limits;
+    FlatHashSet<State> seen;       // canonical states reached
+    vector<vector<Record>> levels, // levels[depth + 1] is being filled
+                           spare;  // emptied levels kept for their memory
+    size_t level,                  // the level being expanded
+           cursor,                 // its next record to expand
+           goal;                   // index of the goal in levels.back()
+    SearchStatus state;
+    SearchStats counters;
+
+    vector<Record> newLevel();
+    void dropLevel();
+    bool withinLimits();
+    void expandOne();
+    public:
+
+    // an idle search, to be started by reset().
+    SteppingSearch();
+    SteppingSearch(Problem*, const SearchLimits& = SearchLimits());
+
+    // drops the current search and starts a new one.
+    void reset(Problem*, const SearchLimits& = SearchLimits());
+
+    // expands up to n states, returning the status afterwards.
+    SearchStatus step(size_t n = 1);
+    // expands states until the time slice has passed.
+    SearchStatus stepFor(chrono::nanoseconds);
+    // expands the rest of the current level.
+    SearchStatus stepLevel();
+    // runs the search to the end.
+    SearchStatus run();
+
+    SearchStatus status() const { return state; }
+    // returns the depth of the states being expanded.
+    size_t depth() const { return level; }
+    // returns the number of states reached but not yet expanded.
+    size_t frontier() const;
+    const SearchStats& stats() const { return counters; }
+    // returns the actions to the goal once solved, else nothing.
+    deque<Action> solution() const;
+};
+
+SteppingSearch::SteppingSearch()
+    : prob(nullptr), level(0), cursor(0), goal(0), state(Unsolvable)
+{
+}
+
+SteppingSearch::SteppingSearch(Problem* p, const SearchLimits& limits)
+{
+    reset(p, limits);
+}
+
+void SteppingSearch::reset(Problem* p, const SearchLimits& lim)
+{
+    prob = p;
+    limits = lim;
+    level = cursor = goal = 0;
+    state = Running;
+    counters = SearchStats();
+    seen.clear();
+    while(!levels.empty())
+        dropLevel();
+
+    levels.push_back(newLevel());
+    levels[0].push_back({ p->getInitial(), 0, 0 });
+    levels.push_back(newLevel());
+    seen.insert(p->canonical(p->getInitial()));
+    if(p->goal_test(p->getInitial()))
+    {
+        dropLevel();
+        state = Solved;
+    }
+    counters.stored = seen.size();
+    counters.status = state;
+}
+
+// returns an empty level, with the memory of a dropped one if any.
+vector<SteppingSearch::Record> SteppingSearch::newLevel()
+{
+    if(spare.empty())
+        return vector<Record>();
+    vector<Record> l = move(spare.back());
+    spare.pop_back();
+    return l;
+}
+
+// removes the last level, keeping its memory for newLevel().
+void SteppingSearch::dropLevel()
+{
+    levels.back().clear();
+    spare.push_back(move(levels.back()));
+    levels.pop_back();
+}
 
-    deque<short> solution = BFS(b);
+// ends the search if a limit is reached, returning false.
+bool SteppingSearch::withinLimits()
+{
+    state = checkLimits(limits, counters.expanded, level);
+    counters.status = state;
+    return state == Running;
+}
 
-    // translate the actions
-    for(short action : solution)
+void SteppingSearch::expandOne()
+{
+    if(!withinLimits())
+        return;
+    vector<Record>& next = levels[level + 1];
+    State s = levels[level][cursor].state;
+    counters.expanded++;
+    for(Action a : prob->actions(s))
     {
-        switch(action)
+        State child = prob->result(s, a);
+        counters.generated++;
+        if(!seen.insert(prob->canonical(child)))
+            continue;
+        next.push_back({ child, a, cursor });
+        if(prob->goal_test(child))
         {
-            case RP:
-                cout << "Peasant crosses right." << endl;
-            break;
-            case RP|RC:
-                cout << "Peasant and cabbage crosses right." << endl;
-            break;
-            case RP|RG:
-                cout << "Peasant and goat crosses right." << endl;
-            break;
-            case RP|RW:
-                cout << "Peasant and wolf crosses right." << endl;
-            break;
-            case LP:
-                cout << "Peasant crosses left." << endl;
-            break;
-            case LP|LC:
-                cout << "Peasant and cabbage crosses left." << endl;
-            break;
-            case LP|LG:
-                cout << "Peasant and goat crosses left." << endl;
-            break;
-            case LP|LW:
-                cout << "Peasant and wolf crosses left." << endl;
+            goal = next.size() - 1;
+            state = Solved;
             break;
         }
     }
+    counters.stored = seen.size();
+    counters.bytes = seen.bytes();
+    counters.status = state;
+    if(state == Solved || ++cursor < levels[level].size())
+        return;
+
+    // the level is done, move on to the next one
+    if(next.empty())
+    {
+        dropLevel();
+        state = counters.status = Unsolvable;
+        return;
+    }
+    level++;
+    cursor = 0;
+    levels.push_back(newLevel());
+}
+
+SearchStatus SteppingSearch::step(size_t n)
+{
+    for(size_t i = 0; i < n && state == Running; i++)
+        expandOne();
+    return state;
+}
+
+SearchStatus SteppingSearch::stepFor(chrono::nanoseconds slice)
+{
+    // the clock is read every 16 expansions
+    chrono::steady_clock::time_point end = chrono::steady_clock::now() + slice;
+    while(state == Running && chrono::steady_clock::now() < end)
+        step(16);
+    return state;
+}
+
+SearchStatus SteppingSearch::stepLevel()
+{
+    for(size_t d = level; state == Running && level == d; )
+        expandOne();
+    return state;
+}
+
+SearchStatus SteppingSearch::run()
+{
+    while(state == Running)
+        expandOne();
+    return state;
+}
+
+size_t SteppingSearch::frontier() const
+{
+    if(state == Solved || state == Unsolvable)
+        return 0;
+    return levels[level].size() - cursor + levels[level + 1].size();
+}
+
+deque<Action> SteppingSearch::solution() const
+{
+    deque<Action> path;
+    if(state != Solved)
+        return path;
+    size_t i = goal;
+    for(size_t d = levels.size() - 1; d > 0; d--)
+    {
+        path.push_front(levels[d][i].action);
+        i = levels[d][i].parent;
+    }
+    return path;
+}
+
+// maps the (canonical) states of a problem onto dense indices 0..size()-1,
+// so per-state tables can be plain arrays instead of sets of states.
+class StateRanking
+{
+    public:
+    virtual ~StateRanking() {}
+
+    // returns the number of ranked states.
+    virtual size_t size() const = 0;
+    // returns the rank of a state's canonical form, or size() if the state
+    // is not ranked.
+    virtual size_t rank(State) const = 0;
+    // returns the canonical state with the given rank.
+    virtual State unrank(size_t) const = 0;
+};
+
+// ranks the canonical states reachable from a problem's initial state by
+// their position in a sorted table. a bucket directory over the state
+// values narrows rank() to a short binary search, giving a minimal
+// perfect hash for encodings of any sparsity.
+class ReachableRanking : public StateRanking
+{
+    private:
+    const Problem* prob;           // supplies canonical()
+    vector<State> states;          // reachable canonical states, sorted
+    vector<uint32_t> bucket;       // first index of each (s - low) >> shift
+    State low;                     // smallest ranked state
+    int shift;                     // state bits dropped for the bucket index
+    public:
+
+    ReachableRanking(Problem*);
+
+    virtual size_t size() const { return states.size(); }
+    virtual size_t rank(State) const;
+    virtual State unrank(size_t r) const { return states[r]; }
+};
+
+ReachableRanking::ReachableRanking(Problem* p) : prob(p), low(0), shift(0)
+{
+    FlatHashSet<State> seen;
+    State start = p->canonical(p->getInitial());
+    seen.insert(start);
+    states.push_back(start);
+    for(size_t next = 0; next < states.size(); next++)
+        for(Action a : p->actions(states[next]))
+        {
+            State s = p->canonical(p->result(states[next], a));
+            if(seen.insert(s))
+                states.push_back(s);
+        }
+    sort(states.begin(), states.end());
+
+    low = states.front();
+    State span = states.back() - low;
+    while((span >> shift) >= 2 * states.size())
+        shift++;
+    bucket.assign((span >> shift) + 2, 0);
+    for(size_t i = 0, b = 0; b < bucket.size(); b++)
+    {
+        while(i < states.size() && ((states[i] - low) >> shift) < b)
+            i++;
+        bucket[b] = i;
+    }
+}
+
+size_t ReachableRanking::rank(State s) const
+{
+    s = prob->canonical(s);
+    if(s < low || ((s - low) >> shift) + 1 >= bucket.size())
+        return states.size();
+    size_t b = (s - low) >> shift;
+    auto first = states.begin() + bucket[b],
+         last = states.begin() + bucket[b + 1];
+    auto it = lower_bound(first, last, s);
+    return it != last && *it == s ? it - states.begin() : states.size();
+}
+
+unique_ptr<StateRanking> Problem::ranking()
+{
+    return make_unique<ReachableRanking>(this);
+}
+
+// ranks crossing states combinatorially, without enumerating them: every
+// ungrouped item and the peasant is a binary digit, and every group of
+// interchangeable items a digit counting its members on the right bank,
+// which is all a canonical state records about the group.
+class CrossingRanking : public StateRanking
+{
+    private:
+    const CrossingProblem* prob;
+    vector<State> digitMask;       // bits of each digit, lowest digit first
+    vector<size_t> weight;         // place value of each digit
+    size_t count;                  // number of ranks, SIZE_MAX if too many
+    public:
+
+    CrossingRanking(const CrossingProblem*);
+
+    virtual size_t size() const { return count; }
+    virtual size_t rank(State) const;
+    virtual State unrank(size_t) const;
+};
+
+CrossingRanking::CrossingRanking(const CrossingProblem* p) : prob(p), count(1)
+{
+    vector<State> radix;
+    for(State rest = (p->items | p->peasant) & ~(p->symmetry ? p->grouped : 0);
+        rest; rest &= rest - 1)
+    {
+        digitMask.push_back(rest & -rest);
+        radix.push_back(2);
+    }
+    if(p->symmetry)
+        for(size_t g = 0; g < p->groupMask.size(); g++)
+        {
+            digitMask.push_back(p->groupMask[g]);
+            radix.push_back(p->groupFill[g].size());
+        }
+
+    for(size_t i = 0; i < digitMask.size(); i++)
+    {
+        weight.push_back(count);
+        count = count > SIZE_MAX / radix[i] ? SIZE_MAX : count * radix[i];
+    }
+}
+
+size_t CrossingRanking::rank(State s) const
+{
+    s = prob->canonical(s);
+    size_t r = 0;
+    for(size_t i = 0; i < digitMask.size(); i++)
+        r += __builtin_popcountll(s & digitMask[i]) * weight[i];
+    return r;
+}
+
+State CrossingRanking::unrank(size_t r) const
+{
+    State s = 0;
+    for(size_t i = digitMask.size(); i-- > 0; )
+    {
+        size_t digit = r / weight[i];
+        r %= weight[i];
+        if(__builtin_popcountll(digitMask[i]) == 1)
+            s |= digit ? digitMask[i] : 0;
+        else
+            s |= prob->groupFill[i - (digitMask.size() - prob->groupMask.size())][digit];
+    }
+    return s;
+}
+
+unique_ptr<StateRanking> CrossingProblem::ranking()
+{
+    return make_unique<CrossingRanking>(this);
+}
+
+// rebuilds the actions along a path of ranks. the ranks name canonical
+// states, so each step picks an action of the concrete state reached so
+// far whose result falls into the next rank.
+deque<Action> replayRanks(Problem* p, const StateRanking& r, const deque<size_t>& path)
+{
+    deque<Action> solution;
+    State state = p->getInitial();
+    for(size_t i = 1; i < path.size(); i++)
+        for(Action a : p->actions(state))
+            if(r.rank(p->result(state, a)) == path[i])
+            {
+                solution.push_back(a);
+                state = p->result(state, a);
+                break;
+            }
+    return solution;
+}
+
+// BFS over dense ranks: the visited set and the parent links are one
+// array of parent ranks sized to the ranking, and the frontier is a queue
+// of ranks rather than of Node objects.
+deque<Action> rankedBFS(Problem* p, const StateRanking& r, SearchStats* stats = nullptr)
+{
+    const uint32_t UNSEEN = UINT32_MAX;
+    vector<uint32_t> parent(r.size(), UNSEEN),
+                     queue;
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+
+    uint32_t start = r.rank(p->getInitial());
+    parent[start] = start;
+    queue.push_back(start);
+    if(p->goal_test(p->getInitial()))
+        queue.clear();
+
+    for(size_t head = 0; head < queue.size(); head++)
+    {
+        uint32_t x = queue[head];
+        State s = r.unrank(x);
+        st.expanded++;
+
+        for(Action a : p->actions(s))
+        {
+            State child = p->result(s, a);
+            size_t y = r.rank(child);
+            st.generated++;
+            if(y >= parent.size() || parent[y] != UNSEEN)
+                continue;
+            parent[y] = x;
+            queue.push_back(y);
+
+            if(p->goal_test(child))
+            {
+                st.stored = queue.size();
+                deque<size_t> path;
+                for(size_t z = y; z != start; z = parent[z])
+                    path.push_front(z);
+                path.push_front(start);
+                return replayRanks(p, r, path);
+            }
+        }
+    }
+    st.stored = queue.size();
+    return deque<Action>();
+}
+
+// a fixed size array of unsigned codes, each stored in bits bits
+class PackedArray
+{
+    private:
+    vector<uint64_t> words;        // the codes, packed back to back
+    unsigned bits;                 // width of one code, at most 32
+    uint64_t mask;                 // low bits bits set
+    public:
+
+    PackedArray(size_t count, unsigned bits)
+        : words((count * bits + 63) / 64 + 1, 0), bits(bits),
+          mask((uint64_t(1) << bits) - 1) {}
+
+    uint64_t get(size_t i) const
+    {
+        size_t bit = i * bits, w = bit / 64, off = bit % 64;
+        uint64_t v = words[w] >> off;
+        if(off + bits > 64)
+            v |= words[w + 1] << (64 - off);
+        return v & mask;
+    }
+
+    void set(size_t i, uint64_t v)
+    {
+        size_t bit = i * bits, w = bit / 64, off = bit % 64;
+        words[w] = (words[w] & ~(mask << off)) | (v << off);
+        if(off + bits > 64)
+            words[w + 1] = (words[w + 1] & ~(mask >> (64 - off))) | (v >> (64 - off));
+    }
+
+    size_t bytes() const { return words.size() * sizeof(uint64_t); }
+};
+
+// returns the number of bits needed to store values 0..n.
+static unsigned bitsFor(size_t n)
+{
+    unsigned bits = 1;
+    while(bits < 64 && (n >> bits))
+        bits++;
+    return bits;
+}
+
+// BFS that keeps a single packed code per ranked state: 0 for unseen,
+// otherwise 1 + the index of the action in actions(state) that leads
+// back to the state's parent. needs a reversible problem with a known
+// maxActions() and fewer than 2^32 ranks; the path is rebuilt by
+// following those undo actions from the goal. besides the codes, only
+// the current and next level's ranks are held, 4 bytes each.
+deque<Action> packedBFS(Problem* p, const StateRanking& r, SearchStats* stats = nullptr)
+{
+    PackedArray back(r.size(), bitsFor(p->maxActions()));
+    vector<uint32_t> level,
+                     next;
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    st.bytes = back.bytes();
+
+    size_t start = r.rank(p->getInitial()),
+           goal = r.size();
+    back.set(start, 1);    // any nonzero code, the root is never walked past
+    level.push_back(start);
+    st.stored = 1;
+    if(p->goal_test(p->getInitial()))
+        level.clear();
+
+    while(!level.empty() && goal == r.size())
+    {
+        for(size_t x : level)
+        {
+            State s = r.unrank(x);
+            st.expanded++;
+
+            for(Action a : p->actions(s))
+            {
+                State child = p->result(s, a);
+                size_t y = r.rank(child);
+                st.generated++;
+                if(y >= r.size() || back.get(y))
+                    continue;
+
+                // find the child's action that undoes this step
+                State c = r.unrank(y);
+                deque<Action> undo = p->actions(c);
+                size_t i = 0;
+                while(i < undo.size() && r.rank(p->result(c, undo[i])) != x)
+                    i++;
+                back.set(y, i + 1);
+                next.push_back(y);
+                st.stored++;
+
+                if(p->goal_test(child))
+                {
+                    goal = y;
+                    break;
+                }
+            }
+            if(goal != r.size())
+                break;
+        }
+        st.bytes = max(st.bytes, back.bytes() + (level.capacity() + next.capacity()) * sizeof(uint32_t));
+        level.swap(next);
+        next.clear();
+    }
+    if(goal == r.size())
+        return deque<Action>();
+
+    deque<size_t> path;
+    for(size_t y = goal; y != start; )
+    {
+        path.push_front(y);
+        State c = r.unrank(y);
+        y = r.rank(p->result(c, p->actions(c)[back.get(y) - 1]));
+    }
+    path.push_front(start);
+    return replayRanks(p, r, path);
+}
+
+// a fixed set of worker threads fed from a shared task queue
+class ThreadPool
+{
+    private:
+    vector<thread> workers;          // threads running work()
+    deque<function<void()>> tasks;   // queued tasks, oldest first
+    mutex mtx;                       // guards tasks and stopping
+    condition_variable wake;         // signalled when a task is queued
+    bool stopping;                   // set once the pool is shutting down
+
+    void work();
+    public:
+
+    // starts the given number of workers, one per core by default.
+    ThreadPool(unsigned = 0);
+    // runs the tasks still queued, then joins the workers.
+    ~ThreadPool();
+
+    // queues a callable and returns a future for its result.
+    template<class F>
+    auto submit(F f) -> future<decltype(f())>
+    {
+        auto task = make_shared<packaged_task<decltype(f())()>>(move(f));
+        future<decltype(f())> res = task->get_future();
+        {
+            lock_guard<mutex> hold(mtx);
+            tasks.push_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return res;
+    }
+
+    unsigned size() const { return workers.size(); }
+};
+
+ThreadPool::ThreadPool(unsigned n)
+{
+    stopping = false;
+    if(n == 0)
+        n = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < n; i++)
+        workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> hold(mtx);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(thread& t : workers)
+        t.join();
+}
+
+void ThreadPool::work()
+{
+    for(;;)
+    {
+        function<void()> task;
+        {
+            unique_lock<mutex> hold(mtx);
+            wake.wait(hold, [this]() { return stopping || !tasks.empty(); });
+            if(tasks.empty())
+                return;
+            task = move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+
+// BFS that stores nothing but 2 bits per ranked state: 0 for unseen,
+// otherwise 1 + the state's depth mod 3. each level is found by scanning
+// the whole table for the current depth's code, the scan split across a
+// thread pool; children are claimed with an atomic or, which is safe as
+// every writer of a level writes the same code. states three levels
+// older share the current code and get expanded again; their children
+// are all seen already, so that costs time but not correctness. the path
+// is rebuilt from the goal by stepping to a neighbour one level
+// shallower, which needs a reversible problem: a neighbour of a state at
+// depth d sits at depth d-1, d or d+1, and the three codes differ.
+deque<Action> twoBitBFS(Problem* p, const StateRanking& r, unsigned threads = 0,
+                        SearchStats* stats = nullptr)
+{
+    const uint64_t LOW = 0x5555555555555555ull;   // low bit of every entry
+    size_t n = r.size();
+    vector<atomic<uint64_t>> codes((n + 31) / 32);
+    for(atomic<uint64_t>& w : codes)
+        w.store(0, memory_order_relaxed);
+    auto code = [&codes](size_t i)
+    {
+        return (codes[i / 32].load(memory_order_relaxed) >> (i % 32 * 2)) & 3;
+    };
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    st.bytes = codes.size() * sizeof(uint64_t);
+
+    size_t start = r.rank(p->getInitial()),
+           goal = r.rank(p->getGoal());
+    if(start >= n || goal >= n)
+        return deque<Action>();
+    codes[start / 32].store(uint64_t(1) << (start % 32 * 2));
+    st.stored = 1;
+
+    ThreadPool pool(threads);
+    size_t depth = 0;
+    while(code(goal) == 0)
+    {
+        uint64_t cur = depth % 3 + 1,
+                 next = (depth + 1) % 3 + 1;
+        size_t chunks = min(codes.size(), size_t(pool.size()) * 8),
+               per = (codes.size() + chunks - 1) / chunks;
+
+        vector<future<array<size_t, 3>>> parts;
+        for(size_t from = 0; from < codes.size(); from += per)
+            parts.push_back(pool.submit([&, from]()
+            {
+                array<size_t, 3> count = { 0, 0, 0 };   // expanded, generated, new
+                size_t to = min(codes.size(), from + per);
+                for(size_t w = from; w < to; w++)
+                {
+                    // entries equal to cur leave a zero pair in diff
+                    uint64_t diff = codes[w].load(memory_order_relaxed) ^ (cur * LOW);
+                    uint64_t hits = ~(diff | diff >> 1) & LOW;
+                    for(; hits; hits &= hits - 1)
+                    {
+                        size_t x = w * 32 + __builtin_ctzll(hits) / 2;
+                        if(x >= n)
+                            break;
+                        State s = r.unrank(x);
+                        count[0]++;
+                        for(Action a : p->actions(s))
+                        {
+                            size_t y = r.rank(p->result(s, a));
+                            count[1]++;
+                            if(y >= n || code(y))
+                                continue;
+                            uint64_t bit = next << (y % 32 * 2);
+                            if(!(codes[y / 32].fetch_or(bit) & (uint64_t(3) << (y % 32 * 2))))
+                                count[2]++;
+                        }
+                    }
+                }
+                return count;
+            }));
+
+        size_t added = 0;
+        for(future<array<size_t, 3>>& f : parts)
+        {
+            array<size_t, 3> count = f.get();
+            st.expanded += count[0];
+            st.generated += count[1];
+            added += count[2];
+        }
+        st.stored += added;
+        if(added == 0)
+            return deque<Action>();
+        depth++;
+    }
+
+    deque<size_t> path(1, goal);
+    for(size_t d = depth; d > 0; d--)
+    {
+        State c = r.unrank(path.front());
+        for(Action a : p->actions(c))
+        {
+            size_t y = r.rank(p->result(c, a));
+            if(y < n && code(y) == (d - 1) % 3 + 1)
+            {
+                path.push_front(y);
+                break;
+            }
+        }
+    }
+    return replayRanks(p, r, path);
+}
+
+
+// level synchronous BFS on a thread pool: each level is split into
+// slices that workers expand in parallel, deduplicating against one
+// ConcurrentStateSet. a level is an array of (state, action, parent index)
+// records, so the path is rebuilt by following parent indices back from
+// the goal. Problem::actions() and result() are called concurrently.
+deque<Action> parallelBFS(Problem* p, unsigned threads = 0, SearchStats* stats = nullptr)
+{
+    struct Record
+    {
+        State state;               // concrete state reached
+        Action action;             // action that reached it
+        size_t parent;             // index of the parent in the previous level
+    };
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    ConcurrentStateSet seen;
+    vector<vector<Record>> levels(1, vector<Record>(1, { p->getInitial(), 0, 0 }));
+    seen.insert(p->canonical(p->getInitial()));
+    atomic<bool> found(p->goal_test(p->getInitial()));
+    ThreadPool pool(threads);
+
+    while(!found)
+    {
+        const vector<Record>& level = levels.back();
+        size_t slices = min(level.size(), size_t(pool.size()) * 4),
+               per = (level.size() + slices - 1) / slices;
+        vector<future<vector<Record>>> parts;
+        atomic<size_t> expanded(0), generated(0);
+        for(size_t from = 0; from < level.size(); from += per)
+            parts.push_back(pool.submit([&, from]()
+            {
+                vector<Record> out;
+                size_t to = min(level.size(), from + per), gen = 0;
+                for(size_t i = from; i < to; i++)
+                    for(Action a : p->actions(level[i].state))
+                    {
+                        State child = p->result(level[i].state, a);
+                        gen++;
+                        if(seen.insert(p->canonical(child)))
+                        {
+                            out.push_back({ child, a, i });
+                            if(p->goal_test(child))
+                                found = true;
+                        }
+                    }
+                expanded += to - from;
+                generated += gen;
+                return out;
+            }));
+
+        vector<Record> next;
+        for(future<vector<Record>>& f : parts)
+        {
+            vector<Record> out = f.get();
+            next.insert(next.end(), out.begin(), out.end());
+        }
+        st.expanded += expanded;
+        st.generated += generated;
+        if(next.empty())
+            break;
+        levels.push_back(move(next));
+    }
+    st.stored = seen.size();
+    st.bytes = seen.bytes();
+
+    deque<Action> solution;
+    if(!found || levels.size() == 1)
+        return solution;
+    size_t i = 0;
+    while(!p->goal_test(levels.back()[i].state))
+        i++;
+    for(size_t d = levels.size() - 1; d > 0; d--)
+    {
+        solution.push_front(levels[d][i].action);
+        i = levels[d][i].parent;
+    }
+    return solution;
+}
+
+// a FIFO that blocks producers while full and consumers while empty
+template<class T>
+class BoundedQueue
+{
+    private:
+    deque<T> items;                  // queued items, oldest first
+    size_t capacity;                 // push() blocks beyond this many items
+    bool closed;                     // no more items will be pushed
+    mutex mtx;
+    condition_variable notFull,
+                       notEmpty;
+    public:
+
+    BoundedQueue(size_t capacity) : capacity(capacity), closed(false) {}
+
+    // appends an item, waiting for room if the queue is full.
+    void push(T item)
+    {
+        unique_lock<mutex> hold(mtx);
+        notFull.wait(hold, [this]() { return items.size() < capacity; });
+        items.push_back(move(item));
+        notEmpty.notify_one();
+    }
+
+    // appends an item if there is room, returning false otherwise.
+    bool tryPush(T& item)
+    {
+        lock_guard<mutex> hold(mtx);
+        if(items.size() >= capacity)
+            return false;
+        items.push_back(move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // removes the oldest item, waiting for one to arrive. returns false
+    // once the queue is closed and drained.
+    bool pop(T& item)
+    {
+        unique_lock<mutex> hold(mtx);
+        notEmpty.wait(hold, [this]() { return closed || !items.empty(); });
+        if(items.empty())
+            return false;
+        item = move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    // wakes consumers once the remaining items are gone.
+    void close()
+    {
+        lock_guard<mutex> hold(mtx);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+    size_t size()
+    {
+        lock_guard<mutex> hold(mtx);
+        return items.size();
+    }
+};
+
+
+// collects small writes into one large buffer and hands them to the
+// stream in big chunks, without flushing the stream itself.
+class BufferedWriter
+{
+    private:
+    FILE* out;                       // destination stream
+    vector<char> buf;                // pending bytes
+    size_t used;                     // number of bytes of buf in use
+    public:
+
+    BufferedWriter(FILE* out, size_t size = 1 << 20)
+        : out(out), buf(size), used(0) {}
+    ~BufferedWriter() { flush(); }
+
+    void write(const char*, size_t);
+    void write(const string& s) { write(s.data(), s.size()); }
+    // hands the buffered bytes to the stream.
+    void flush();
+};
+
+void BufferedWriter::write(const char* data, size_t n)
+{
+    if(used + n > buf.size())
+    {
+        flush();
+        if(n > buf.size())
+        {
+            fwrite(data, 1, n, out);
+            return;
+        }
+    }
+    memcpy(buf.data() + used, data, n);
+    used += n;
+}
+
+void BufferedWriter::flush()
+{
+    if(used)
+        fwrite(buf.data(), 1, used, out);
+    used = 0;
+}
+
+
+// reads a file of raw States front to back, exposing the current one as
+// head while valid.
+class StateReader
+{
+    private:
+    FILE* in;
+    vector<State> buf;             // states read but not yet consumed
+    size_t pos,                    // index of head in buf
+           len;                    // number of valid states in buf
+    public:
+    State head;                    // the current state
+    bool valid;                    // false once the file is exhausted
+
+    StateReader(const string& path, size_t bufStates = 1 << 14)
+        : in(fopen(path.c_str(), "rb")), buf(max(size_t(1), bufStates)),
+          pos(0), len(0), head(0), valid(true) { advance(); }
+    ~StateReader() { if(in) fclose(in); }
+
+    // moves head to the next state of the file.
+    void advance()
+    {
+        if(++pos >= len)
+        {
+            len = in ? fread(buf.data(), sizeof(State), buf.size(), in) : 0;
+            pos = 0;
+        }
+        valid = pos < len;
+        if(valid)
+            head = buf[pos];
+    }
+};
+
+// settings for externalBFS()
+struct ExternalConfig
+{
+    string dir;                    // where level, run and checkpoint files go,
+                                   // a private ScratchDir if empty
+    size_t memory = 64 << 20;      // bytes for successor buffers
+    unsigned threads = 0;          // run sorting threads, 0 for one per core
+    bool resume = false;           // continue from the checkpoint in dir
+};
+
+// the directory a search keeps its files in: the one asked for, or if
+// none was, a fresh one only this process can enter, made by mkdtemp in
+// $TMPDIR or /tmp. a directory made here is removed with its contents
+// when the ScratchDir goes.
+class ScratchDir
+{
+    private:
+    string path;                   // the directory, empty if none could be made
+    bool made;                     // true if it was made here
+    public:
+
+    ScratchDir(const string& dir);
+    ~ScratchDir();
+    ScratchDir(const ScratchDir&) = delete;
+    ScratchDir& operator=(const ScratchDir&) = delete;
+
+    bool valid() const { return !path.empty(); }
+    const string& str() const { return path; }
+};
+
+ScratchDir::ScratchDir(const string& dir) : path(dir), made(false)
+{
+    if(!path.empty())
+        return;
+    const char* tmp = getenv("TMPDIR");
+    string name = string(tmp && *tmp ? tmp : "/tmp") + "/bfs-XXXXXX";
+    if(mkdtemp(name.data()))
+    {
+        path = name;
+        made = true;
+    }
+    else
+        perror(name.c_str());
+}
+
+ScratchDir::~ScratchDir()
+{
+    error_code ignored;
+    if(made)
+        filesystem::remove_all(path, ignored);
+}
+
+// closes a file that was written, returning false if any write to it
+// failed, flushing included.
+static bool finishFile(FILE* f)
+{
+    bool ok = !ferror(f);
+    return fclose(f) == 0 && ok;
+}
+
+// true if the sorted state file at path contains s.
+static bool fileContains(const string& path, State s)
+{
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f)
+        return false;
+    fseek(f, 0, SEEK_END);
+    size_t lo = 0, hi = ftell(f) / sizeof(State);
+    bool found = false;
+    while(lo < hi && !found)
+    {
+        size_t mid = (lo + hi) / 2;
+        State v;
+        fseek(f, mid * sizeof(State), SEEK_SET);
+        if(fread(&v, sizeof v, 1, f) != 1)
+            break;
+        found = v == s;
+        if(v < s)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    fclose(f);
+    return found;
+}
+
+// rebuilds the actions along a path of canonical states, picking at each
+// step an action of the concrete state whose result is symmetric to the
+// next state on the path.
+deque<Action> replayCanonical(Problem* p, const deque<State>& path)
+{
+    deque<Action> solution;
+    State state = p->getInitial();
+    for(size_t i = 1; i < path.size(); i++)
+        for(Action a : p->actions(state))
+            if(p->canonical(p->result(state, a)) == path[i])
+            {
+                solution.push_back(a);
+                state = p->result(state, a);
+                break;
+            }
+    return solution;
+}
+
+// disk based BFS with delayed duplicate detection (Korf). every level
+// is a sorted file of canonical states. expanding a level fills memory
+// sized successor buffers, which the pool sorts, deduplicates and writes
+// as run files while expansion continues; the runs are then merged and
+// anything already in the two previous levels is dropped to give the next
+// level. that suffices for a reversible problem, whose successors of
+// level d lie in levels d-1, d and d+1. a checkpoint file records every
+// finished level, so a crashed search can resume from it. the level files
+// stay until the end and the path is rebuilt by looking up, level by
+// level, a neighbour of the goal's chain in the file one level shallower.
+// the checkpoint names the problem's fingerprint() and endpoints, and a
+// resume of any other problem is refused. a file that cannot be opened
+// or written ends the search with status Failed. the fixed file names
+// are only used in a directory the caller named; otherwise the files go
+// in a private ScratchDir, and such a search cannot be resumed.
+deque<Action> externalBFS(Problem* p, const ExternalConfig& cfg, SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    if(cfg.resume && cfg.dir.empty())
+    {
+        fprintf(stderr, "--resume needs the --temp-dir of the interrupted search\n");
+        st.status = Failed;
+        return deque<Action>();
+    }
+    ScratchDir scratch(cfg.dir);
+    if(!scratch.valid())
+    {
+        st.status = Failed;
+        return deque<Action>();
+    }
+    const string& dir = scratch.str();
+    auto levelPath = [&dir](size_t d) { return dir + "/level-" + to_string(d) + ".bin"; };
+    auto runPath = [&dir](size_t k) { return dir + "/run-" + to_string(k) + ".bin"; };
+    string checkpoint = dir + "/checkpoint";
+    auto fail = [&st](const string& path)
+    {
+        perror(path.c_str());
+        st.status = Failed;
+        return deque<Action>();
+    };
+
+    size_t depth = 0;
+    State goal = 0;
+    bool found = false;
+    FILE* f = cfg.resume ? fopen(checkpoint.c_str(), "r") : nullptr;
+    if(f)
+    {
+        unsigned long long rules, initial, target;
+        if(fscanf(f, "%llx %llx %llx %zu %zu %zu %zu %zu", &rules, &initial, &target, &depth,
+                  &st.stored, &st.expanded, &st.generated, &st.diskBytes) != 8)
+            depth = 0;
+        fclose(f);
+        if(depth && (rules != p->fingerprint() || initial != p->getInitial()
+                     || target != p->getGoal()))
+        {
+            fprintf(stderr, "the checkpoint in %s belongs to another problem\n", dir.c_str());
+            st.status = Failed;
+            return deque<Action>();
+        }
+
+        // the goal may sit in the last finished level
+        for(StateReader level(levelPath(depth)); depth && level.valid && !found; level.advance())
+            if(p->goal_test(level.head))
+            {
+                found = true;
+                goal = level.head;
+            }
+    }
+    if(depth == 0)
+    {
+        st = SearchStats();
+        State start = p->canonical(p->getInitial());
+        if(!(f = fopen(levelPath(0).c_str(), "wb")))
+            return fail(levelPath(0));
+        BufferedWriter(f).write((const char*)&start, sizeof start);
+        if(!finishFile(f))
+            return fail(levelPath(0));
+        st.stored = 1;
+        found = p->goal_test(p->getInitial());
+        goal = start;
+    }
+
+    ThreadPool pool(cfg.threads);
+    size_t perBuffer = max(size_t(1024), cfg.memory / sizeof(State) / (pool.size() + 1));
+    st.bytes = perBuffer * sizeof(State) * (pool.size() + 1);
+    auto removeRuns = [&runPath](size_t runs)
+    {
+        for(size_t k = 0; k < runs; k++)
+            remove(runPath(k).c_str());
+    };
+
+    while(!found)
+    {
+        // expand level depth into sorted runs
+        deque<future<size_t>> sorting;
+        size_t runs = 0;
+        atomic<bool> runFailed(false);
+        string failedRun;
+        vector<State> buf;
+        buf.reserve(perBuffer);
+        auto flush = [&]()
+        {
+            if(sorting.size() >= pool.size())
+            {
+                st.diskBytes += sorting.front().get();
+                sorting.pop_front();
+            }
+            string path = runPath(runs++);
+            sorting.push_back(pool.submit([run = move(buf), path, &runFailed]() mutable
+            {
+                sort(run.begin(), run.end());
+                run.erase(unique(run.begin(), run.end()), run.end());
+                FILE* out = fopen(path.c_str(), "wb");
+                if(out)
+                    BufferedWriter(out).write((const char*)run.data(), run.size() * sizeof(State));
+                if(!out || !finishFile(out))
+                {
+                    perror(path.c_str());
+                    runFailed = true;
+                }
+                return run.size() * sizeof(State);
+            }));
+            buf = vector<State>();
+            buf.reserve(perBuffer);
+        };
+        for(StateReader level(levelPath(depth)); level.valid; level.advance())
+        {
+            st.expanded++;
+            for(Action a : p->actions(level.head))
+            {
+                buf.push_back(p->canonical(p->result(level.head, a)));
+                st.generated++;
+                if(buf.size() == perBuffer)
+                    flush();
+            }
+        }
+        if(!buf.empty())
+            flush();
+        for(future<size_t>& s : sorting)
+            st.diskBytes += s.get();
+        if(runFailed)
+        {
+            removeRuns(runs);
+            st.status = Failed;
+            return deque<Action>();
+        }
+
+        // merge the runs, dropping states of the two previous levels
+        size_t readBuf = max(size_t(512), perBuffer / (runs + 2));
+        vector<unique_ptr<StateReader>> in;
+        priority_queue<pair<State, size_t>, vector<pair<State, size_t>>,
+                       greater<pair<State, size_t>>> heads;
+        for(size_t k = 0; k < runs; k++)
+        {
+            in.push_back(make_unique<StateReader>(runPath(k), readBuf));
+            if(in[k]->valid)
+                heads.push({ in[k]->head, k });
+        }
+        StateReader prev(levelPath(depth), readBuf),
+                    prev2(depth ? levelPath(depth - 1) : string(), readBuf);
+
+        FILE* out = fopen(levelPath(depth + 1).c_str(), "wb");
+        if(!out)
+        {
+            removeRuns(runs);
+            return fail(levelPath(depth + 1));
+        }
+        size_t added = 0;
+        {
+            BufferedWriter w(out);
+            bool any = false;
+            State last = 0;
+            while(!heads.empty())
+            {
+                auto [s, k] = heads.top();
+                heads.pop();
+                in[k]->advance();
+                if(in[k]->valid)
+                    heads.push({ in[k]->head, k });
+                if(any && s == last)
+                    continue;
+                any = true;
+                last = s;
+
+                while(prev.valid && prev.head < s)
+                    prev.advance();
+                while(prev2.valid && prev2.head < s)
+                    prev2.advance();
+                if((prev.valid && prev.head == s) || (prev2.valid && prev2.head == s))
+                    continue;
+
+                w.write((const char*)&s, sizeof s);
+                added++;
+                if(!found && p->goal_test(s))
+                {
+                    found = true;
+                    goal = s;
+                }
+            }
+        }
+        in.clear();
+        removeRuns(runs);
+        if(!finishFile(out))
+            return fail(levelPath(depth + 1));
+        st.diskBytes += added * sizeof(State);
+        st.stored += added;
+        if(added == 0)
+            break;
+        depth++;
+
+        // the level is complete: record it, replacing the old checkpoint
+        // only once the new one is safely written
+        string tmp = checkpoint + ".tmp";
+        if(!(f = fopen(tmp.c_str(), "w")))
+            return fail(tmp);
+        fprintf(f, "%llx %llx %llx %zu %zu %zu %zu %zu\n",
+                (unsigned long long)p->fingerprint(), p->getInitial(), p->getGoal(), depth,
+                st.stored, st.expanded, st.generated, st.diskBytes);
+        if(!finishFile(f))
+        {
+            remove(tmp.c_str());
+            return fail(tmp);
+        }
+        if(rename(tmp.c_str(), checkpoint.c_str()) != 0)
+            return fail(checkpoint);
+    }
+
+    deque<State> path;
+    if(found)
+    {
+        path.push_back(goal);
+        for(size_t d = depth; d > 0; d--)
+            for(Action a : p->actions(path.front()))
+            {
+                State s = p->canonical(p->result(path.front(), a));
+                if(fileContains(levelPath(d - 1), s))
+                {
+                    path.push_front(s);
+                    break;
+                }
+            }
+    }
+    for(size_t d = 0; d <= depth + 1; d++)
+        remove(levelPath(d).c_str());
+    remove(checkpoint.c_str());
+    return found ? replayCanonical(p, path) : deque<Action>();
+}
+
+
+#ifdef __SSSE3__
+// control byte tables for stream-vbyte decoding: the byte length of the
+// four values a control byte describes, and the shuffle that spreads
+// their bytes over four 32-bit lanes.
+struct StreamVByteTables
+{
+    uint8_t length[256];
+    uint8_t shuffle[256][16];
+
+    StreamVByteTables()
+    {
+        for(int c = 0; c < 256; c++)
+        {
+            int pos = 0;
+            for(int j = 0; j < 4; j++)
+            {
+                int len = ((c >> (2 * j)) & 3) + 1;
+                for(int b = 0; b < 4; b++)
+                    shuffle[c][4 * j + b] = b < len ? pos + b : 0x80;
+                pos += len;
+            }
+            length[c] = pos;
+        }
+    }
+};
+
+static const StreamVByteTables& streamVByte()
+{
+    static const StreamVByteTables tables;
+    return tables;
+}
+#endif
+
+// an ascending sequence of states stored in chunks of up to CHUNK states.
+// a chunk is a header (state count, gap encoding, payload bytes, first
+// state) and the gaps between consecutive states. gaps that all fit in 32
+// bits are stream-vbyte coded: a control byte per four gaps giving each
+// one's length in bytes, then the gaps' significant bytes. other chunks
+// keep the gaps raw. decoding runs front to back a chunk at a time, with
+// SSSE3 shuffles when the compiler targets them.
+class CompressedStates
+{
+    public:
+    static constexpr size_t CHUNK = 256;
+    static constexpr size_t HEADER = 2 + 1 + 4 + 8;
+
+    private:
+    vector<uint8_t> data;          // the encoded chunks
+    vector<State> pending;         // states not yet encoded, at most CHUNK
+    size_t count;                  // states in data and pending
+
+    void encodeChunk();
+    public:
+
+    CompressedStates() : count(0) {}
+
+    // appends a state larger than every state before it.
+    void push_back(State s)
+    {
+        pending.push_back(s);
+        count++;
+        if(pending.size() == CHUNK)
+            encodeChunk();
+    }
+
+    // encodes the states still pending and releases spare capacity.
+    void finish()
+    {
+        if(!pending.empty())
+            encodeChunk();
+        vector<State>().swap(pending);
+        data.shrink_to_fit();
+    }
+
+    size_t size() const { return count; }
+    size_t bytes() const { return data.capacity() + pending.capacity() * sizeof(State); }
+    const vector<uint8_t>& encoded() const { return data; }
+
+    // decodes the chunk at p into out, which must hold CHUNK states. end
+    // bounds the readable bytes. returns the number of states and moves p
+    // past the chunk; a chunk that is malformed or runs past end gives no
+    // states and moves p to end.
+    static size_t decodeChunk(const uint8_t*& p, const uint8_t* end, State* out);
+
+    // calls visit on every state in order until it returns false.
+    template<class F>
+    void forEach(F visit) const
+    {
+        State chunk[CHUNK];
+        const uint8_t* end = data.data() + data.size();
+        for(const uint8_t* p = data.data(); p < end; )
+        {
+            size_t n = decodeChunk(p, end, chunk);
+            for(size_t i = 0; i < n; i++)
+                if(!visit(chunk[i]))
+                    return;
+        }
+        for(State s : pending)
+            if(!visit(s))
+                return;
+    }
+};
+
+void CompressedStates::encodeChunk()
+{
+    size_t n = pending.size();
+    bool narrow = true;
+    for(size_t i = 1; i < n; i++)
+        narrow = narrow && pending[i] - pending[i - 1] <= UINT32_MAX;
+
+    size_t at = data.size();
+    data.resize(at + HEADER);
+    uint16_t n16 = n;
+    memcpy(&data[at], &n16, 2);
+    data[at + 2] = narrow;
+    memcpy(&data[at + 7], &pending[0], 8);
+
+    if(narrow)
+    {
+        size_t ctrl = data.size();
+        data.resize(ctrl + (n + 2) / 4, 0);
+        for(size_t i = 1; i < n; i++)
+        {
+            uint32_t gap = pending[i] - pending[i - 1];
+            int len = gap < (1u << 8) ? 1 : gap < (1u << 16) ? 2 : gap < (1u << 24) ? 3 : 4;
+            data[ctrl + (i - 1) / 4] |= (len - 1) << (2 * ((i - 1) % 4));
+            for(int b = 0; b < len; b++)
+                data.push_back(gap >> (8 * b));
+        }
+    }
+    else
+        for(size_t i = 1; i < n; i++)
+        {
+            State gap = pending[i] - pending[i - 1];
+            data.insert(data.end(), (uint8_t*)&gap, (uint8_t*)&gap + 8);
+        }
+
+    uint32_t payload = data.size() - at - HEADER;
+    memcpy(&data[at + 3], &payload, 4);
+    pending.clear();
+}
+
+size_t CompressedStates::decodeChunk(const uint8_t*& p, const uint8_t* end, State* out)
+{
+    uint16_t n;
+    uint32_t payload;
+    if(size_t(end - p) < HEADER)
+    {
+        p = end;
+        return 0;
+    }
+    memcpy(&n, p, 2);
+    bool narrow = p[2];
+    memcpy(&payload, p + 3, 4);
+    const uint8_t* ctrl = p + HEADER;
+    size_t gaps = n - 1;
+    if(n == 0 || n > CHUNK || payload > size_t(end - ctrl)
+       || payload < (narrow ? (gaps + 3) / 4 + gaps : 8 * gaps))
+    {
+        p = end;
+        return 0;
+    }
+    memcpy(&out[0], p + 7, 8);
+    p = ctrl + payload;
+
+    if(!narrow)
+    {
+        for(size_t i = 0; i < gaps; i++)
+        {
+            State gap;
+            memcpy(&gap, ctrl + 8 * i, 8);
+            out[i + 1] = out[i] + gap;
+        }
+        return n;
+    }
+
+    uint32_t gap[CHUNK + 3];
+    const uint8_t* in = ctrl + (gaps + 3) / 4;
+    size_t i = 0;
+#ifdef __SSSE3__
+    const StreamVByteTables& t = streamVByte();
+    // the load may run past the chunk into the buffer, never past end,
+    // but the bytes a group uses must lie within the chunk
+    for(; i + 4 <= gaps && in + 16 <= end; i += 4)
+    {
+        uint8_t c = ctrl[i / 4];
+        if(in + t.length[c] > p)
+        {
+            p = end;
+            return 0;
+        }
+        __m128i v = _mm_loadu_si128((const __m128i*)in);
+        v = _mm_shuffle_epi8(v, _mm_loadu_si128((const __m128i*)t.shuffle[c]));
+        _mm_storeu_si128((__m128i*)&gap[i], v);
+        in += t.length[c];
+    }
+#endif
+    for(; i < gaps; i++)
+    {
+        int len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        if(in + len > p)
+        {
+            p = end;
+            return 0;
+        }
+        uint32_t v = 0;
+        for(int b = 0; b < len; b++)
+            v |= uint32_t(in[b]) << (8 * b);
+        gap[i] = v;
+        in += len;
+    }
+    for(i = 0; i < gaps; i++)
+        out[i + 1] = out[i] + gap[i];
+    return n;
+}
+
+// one BFS level: a compressed ascending run of canonical states that can
+// be moved to a file when memory runs short, and streamed back from it.
+class LevelSegment
+{
+    private:
+    CompressedStates states;       // the level while in memory
+    string path;                   // the file while spilled
+    size_t count;                  // number of states in the level
+    public:
+
+    LevelSegment(const vector<State>& sorted) : count(sorted.size())
+    {
+        for(State s : sorted)
+            states.push_back(s);
+        states.finish();
+    }
+    ~LevelSegment() { if(!path.empty()) remove(path.c_str()); }
+    LevelSegment(const LevelSegment&) = delete;
+    LevelSegment& operator=(const LevelSegment&) = delete;
+
+    bool spilled() const { return !path.empty(); }
+    size_t size() const { return count; }
+    size_t bytes() const { return states.bytes(); }
+
+    // writes the encoded states to the file at path and frees them,
+    // returning the bytes written, or 0 with errno set if the file could
+    // not be written.
+    size_t spill(const string& path);
+
+    // calls visit on every state in ascending order, streaming them from
+    // the file if spilled, until visit returns false. returns false after
+    // reporting it if the spilled file could not be read in full.
+    bool forEach(const function<bool(State)>& visit) const;
+};
+
+size_t LevelSegment::spill(const string& file)
+{
+    FILE* out = fopen(file.c_str(), "wb");
+    if(!out)
+        return 0;
+    const vector<uint8_t>& data = states.encoded();
+    BufferedWriter(out).write((const char*)data.data(), data.size());
+    if(!finishFile(out))
+    {
+        int error = errno;
+        remove(file.c_str());
+        errno = error;
+        return 0;
+    }
+    path = file;
+    size_t written = data.size();
+    states = CompressedStates();
+    return written;
+}
+
+bool LevelSegment::forEach(const function<bool(State)>& visit) const
+{
+    if(!spilled())
+    {
+        states.forEach(visit);
+        return true;
+    }
+
+    FILE* in = fopen(path.c_str(), "rb");
+    if(!in)
+    {
+        perror(path.c_str());
+        return false;
+    }
+    vector<uint8_t> chunk;
+    State decoded[CompressedStates::CHUNK];
+    uint8_t header[CompressedStates::HEADER];
+    bool more = true, complete = true;
+    while(more)
+    {
+        size_t got = fread(header, 1, sizeof header, in);
+        if(got == 0 && feof(in))
+            break;
+        uint32_t payload;
+        memcpy(&payload, header + 3, 4);
+        if(got == sizeof header)
+        {
+            chunk.assign(header, header + sizeof header);
+            chunk.resize(sizeof header + payload);
+        }
+        if(got != sizeof header || fread(&chunk[sizeof header], 1, payload, in) != payload)
+        {
+            complete = false;
+            break;
+        }
+        const uint8_t* p = chunk.data();
+        size_t n = CompressedStates::decodeChunk(p, chunk.data() + chunk.size(), decoded);
+        for(size_t i = 0; i < n && more; i++)
+            more = visit(decoded[i]);
+    }
+    fclose(in);
+    if(!complete)
+        fprintf(stderr, "%s: spilled level is truncated\n", path.c_str());
+    return complete;
+}
+
+// settings for hybridBFS()
+struct HybridConfig
+{
+    string dir;                    // where spilled levels go, a private
+                                   // ScratchDir if empty
+    size_t threshold = 256 << 20;  // bytes of levels kept in memory
+};
+
+// level synchronous BFS that keeps each level as a compressed sorted run
+// of canonical states and tracks the bytes they hold. past the configured
+// threshold, the coldest (oldest) levels are spilled to files;
+// the two newest always stay in memory. new states are checked against
+// the previous two levels for reversible problems and against every
+// level otherwise, streaming spilled ones back as needed. successors are
+// gathered raw, and whenever they outgrow the room left under the
+// threshold they are sorted and stripped of duplicates and known states,
+// so the buffer holds about the next level's new states rather than every
+// successor of the widest one. spill files go in a private ScratchDir
+// unless a directory was named, under names holding the process id; a
+// level that cannot be spilled stays in memory and the failure is
+// counted. the path is rebuilt backwards by finding, in each
+// shallower level, a state with the next state on the path among its
+// successors. a spilled level that cannot be read back ends the search
+// with status Failed.
+deque<Action> hybridBFS(Problem* p, const HybridConfig& cfg, SearchStats* stats = nullptr)
+{
+    static atomic<uint64_t> searches(0);
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    unique_ptr<ScratchDir> scratch;  // made at the first spill, outlives levels
+    vector<unique_ptr<LevelSegment>> levels;
+    size_t resident = 0;           // bytes of levels in memory
+    string prefix = "/spill-" + to_string(getpid()) + "-" + to_string(searches++) + "-";
+    State goal = p->canonical(p->getInitial());
+    bool found = p->goal_test(p->getInitial());
+
+    levels.push_back(make_unique<LevelSegment>(vector<State>(1, goal)));
+    resident = levels.back()->bytes();
+    st.stored = 1;
+
+    // sorts v and drops duplicates and states already in a level. returns
+    // false if a spilled level could not be read.
+    auto dropKnown = [&](vector<State>& v)
+    {
+        sort(v.begin(), v.end());
+        v.erase(unique(v.begin(), v.end()), v.end());
+        vector<char> seen(v.size(), 0);
+        size_t oldest = p->reversible() && levels.size() > 2 ? levels.size() - 2 : 0;
+        bool read = true;
+        for(size_t d = levels.size(); d-- > oldest; )
+        {
+            if(levels[d]->spilled())
+                st.reloads++;
+            size_t i = 0;
+            read = levels[d]->forEach([&](State s)
+            {
+                while(i < v.size() && v[i] < s)
+                    i++;
+                if(i < v.size() && v[i] == s)
+                    seen[i] = 1;
+                return i < v.size();
+            }) && read;
+        }
+        size_t kept = 0;
+        for(size_t i = 0; i < v.size(); i++)
+            if(!seen[i])
+                v[kept++] = v[i];
+        v.resize(kept);
+        return read;
+    };
+
+    while(!found)
+    {
+        // successors buffered before compacting, at least 64k
+        size_t room = cfg.threshold > resident ? cfg.threshold - resident : 0;
+        size_t limit = max(size_t(1) << 16, room / sizeof(State));
+        vector<State> next;
+        bool read = levels.back()->forEach([&](State s)
+        {
+            st.expanded++;
+            for(Action a : p->actions(s))
+            {
+                next.push_back(p->canonical(p->result(s, a)));
+                st.generated++;
+            }
+            if(next.size() >= limit)
+            {
+                st.bytes = max(st.bytes, resident + next.capacity() * sizeof(State));
+                read = dropKnown(next) && read;
+                // keep the compaction amortized when most states are new
+                if(next.size() > limit / 2)
+                    limit *= 2;
+            }
+            return true;
+        });
+        st.bytes = max(st.bytes, resident + next.capacity() * sizeof(State));
+        read = dropKnown(next) && read;
+        if(!read)
+        {
+            st.status = Failed;
+            return deque<Action>();
+        }
+        for(State s : next)
+            if(p->goal_test(s))
+            {
+                found = true;
+                goal = s;
+                break;
+            }
+        if(next.empty())
+            break;
+        st.stored += next.size();
+        levels.push_back(make_unique<LevelSegment>(next));
+        resident += levels.back()->bytes();
+        next = vector<State>();
+
+        // spill the coldest levels past the threshold
+        for(size_t d = 0; resident > cfg.threshold && d + 2 < levels.size(); d++)
+        {
+            if(levels[d]->spilled())
+                continue;
+            if(!scratch)
+                scratch = make_unique<ScratchDir>(cfg.dir);
+            size_t held = levels[d]->bytes();
+            string path = scratch->str() + prefix + to_string(d) + ".bin";
+            size_t written = scratch->valid() ? levels[d]->spill(path) : 0;
+            if(!written && held)
+            {
+                // the first failure is reported, the rest only counted
+                if(st.failedSpills++ == 0 && scratch->valid())
+                    perror(path.c_str());
+                break;
+            }
+            resident -= held;
+            st.spills++;
+            st.diskBytes += written;
+        }
+        st.bytes = max(st.bytes, resident);
+    }
+    if(!found)
+        return deque<Action>();
+
+    deque<State> path(1, goal);
+    for(size_t d = levels.size() - 1; d > 0; d--)
+    {
+        if(levels[d - 1]->spilled())
+            st.reloads++;
+        bool read = levels[d - 1]->forEach([&](State s)
+        {
+            for(Action a : p->actions(s))
+                if(p->canonical(p->result(s, a)) == path.front())
+                {
+                    path.push_front(s);
+                    return false;
+                }
+            return true;
+        });
+        if(!read)
+        {
+            st.status = Failed;
+            return deque<Action>();
+        }
+    }
+    return replayCanonical(p, path);
+}
+
+
+// a Bloom filter over states: k bits per state, each from its own hash,
+// answer "maybe present" or "certainly absent".
+class BloomFilter
+{
+    private:
+    vector<uint64_t> words;        // the bit array
+    size_t bits;                   // number of bits in use
+    int k;                         // bits set per state
+    size_t count;                  // states inserted
+    StateHash hash;
+
+    // the i-th bit of s. each is a fresh hash: double hashing repeats bit
+    // patterns too often in the small filters of the first levels
+    size_t probe(State s, int i) const { return hash(s + i * 0x9E3779B97F4A7C15ull) % bits; }
+    public:
+
+    BloomFilter(size_t bits, int k)
+        : words((max(size_t(64), bits) + 63) / 64, 0), bits(words.size() * 64), k(k),
+          count(0) {}
+
+    void insert(State s)
+    {
+        for(int i = 0; i < k; i++)
+            words[probe(s, i) / 64] |= uint64_t(1) << (probe(s, i) % 64);
+        count++;
+    }
+
+    bool maybeContains(State s) const
+    {
+        for(int i = 0; i < k; i++)
+            if(!(words[probe(s, i) / 64] >> (probe(s, i) % 64) & 1))
+                return false;
+        return true;
+    }
+
+    // returns the chance that an absent state tests present.
+    double falsePositiveRate() const
+    {
+        return pow(1 - exp(-double(k) * count / bits), k);
+    }
+
+    size_t bytes() const { return words.size() * sizeof(uint64_t); }
+};
+
+// settings for bitstateBFS()
+struct BitstateConfig
+{
+    double bitsPerState = 32;      // filter bits budgeted per stored state
+    int hashes = 8;                // bits set per state
+};
+
+// BFS for reachability sweeps too big to store exactly (bitstate hashing,
+// as in SPIN's supertrace). only the current and next level are held as
+// state arrays; once expanded, a level is replaced by a Bloom filter of
+// bitsPerState bits per state, so the saving is on the finished levels
+// and the peak is set by the two widest neighbouring levels. new states
+// are checked exactly against the current level and through the filters
+// of all finished ones. the previous filter alone would catch every
+// revisit in a reversible problem, but once a false positive delays a
+// state by a level its older neighbours would slip past it, and the
+// sweep could cycle forever; with every filter probed no state is
+// expanded twice, so the sweep ends. a false positive drops a state
+// unexplored, and the expected number of such omissions is reported. the
+// problem must be reversible so the path can be rebuilt backwards through
+// the level filters, backtracking out of the dead ends false positives
+// lead into.
+deque<Action> bitstateBFS(Problem* p, const BitstateConfig& cfg, SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    vector<BloomFilter> filters;   // filters[d] holds level d once expanded
+    vector<State> level(1, p->canonical(p->getInitial())),
+                  next;
+    size_t filterBytes = 0;
+    bool found = p->goal_test(p->getInitial());
+    State goal = level[0];
+    st.stored = 1;
+
+    while(!found && !level.empty())
+    {
+        next.clear();
+        for(State s : level)
+        {
+            st.expanded++;
+            for(Action a : p->actions(s))
+                next.push_back(p->canonical(p->result(s, a)));
+        }
+        st.generated += next.size();
+        sort(next.begin(), next.end());
+        next.erase(unique(next.begin(), next.end()), next.end());
+
+        size_t kept = 0;
+        for(State s : next)
+        {
+            // newest first: that filter catches nearly every revisit
+            if(binary_search(level.begin(), level.end(), s)
+                || any_of(filters.rbegin(), filters.rend(),
+                          [s](const BloomFilter& f) { return f.maybeContains(s); }))
+                continue;
+            next[kept++] = s;
+            if(!found && p->goal_test(s))
+            {
+                found = true;
+                goal = s;
+            }
+        }
+        next.resize(kept);
+
+        // each truly new state passed every filter, which one in (1 - rate)
+        // of them do, so kept states stand for kept / (1 - rate) new ones
+        double pass = 1;
+        for(const BloomFilter& f : filters)
+            pass *= 1 - f.falsePositiveRate();
+        st.omitted += kept * (1 - pass) / pass;
+
+        BloomFilter f(size_t(cfg.bitsPerState * level.size()), cfg.hashes);
+        for(State s : level)
+            f.insert(s);
+        filterBytes += f.bytes();
+        filters.push_back(move(f));
+
+        st.bytes = max(st.bytes, filterBytes + (level.capacity() + next.capacity()) * sizeof(State));
+        st.stored += next.size();
+        level.swap(next);
+    }
+    if(!found)
+        return deque<Action>();
+
+    // walk back from the goal through the filters of levels depth-1 .. 0
+    State start = p->canonical(p->getInitial());
+    deque<State> path(1, goal);
+    function<bool(size_t)> back = [&](size_t d)
+    {
+        if(d == 0)
+            return path.front() == start;
+        State c = path.front();
+        for(Action a : p->actions(c))
+        {
+            State y = p->canonical(p->result(c, a));
+            if(!filters[d - 1].maybeContains(y))
+                continue;
+            path.push_front(y);
+            if(back(d - 1))
+                return true;
+            path.pop_front();
+        }
+        return false;
+    };
+    if(!back(filters.size()))
+        return deque<Action>();
+    return replayCanonical(p, path);
+}
+
+// returns the sum of the costs of the actions along a path.
+size_t pathCost(Problem* p, const deque<Action>& path)
+{
+    size_t total = 0;
+    State state = p->getInitial();
+    for(Action a : path)
+    {
+        total += p->cost(state, a);
+        state = p->result(state, a);
+    }
+    return total;
+}
+
+// A* over the action costs of Problem::cost(), guided by
+// Problem::heuristic(), or Dijkstra's algorithm if not guided. costs are
+// small whole numbers and f = g + h never decreases along the expansion
+// order for a consistent heuristic, so the open list is an array of
+// buckets indexed by f (Dial's bucket queue) instead of a binary heap,
+// and a pop costs no more than BFS's. within a bucket the most recent entry
+// is taken first, which favours the deeper states. a state can be
+// reached again by a cheaper path before it is expanded: its record is
+// then updated in place and reinserted, and the stale entry is skipped
+// when it comes up. the goal is tested on expansion and expanded states
+// are never reopened, so the path is optimal for a consistent heuristic.
+deque<Action> aStar(Problem* p, bool guided = true, SearchStats* stats = nullptr)
+{
+    struct Record
+    {
+        State state;               // concrete state reached
+        Action action;             // action that reached it
+        size_t parent,             // index of the parent record
+               g;                  // cost from the initial state
+        bool closed;               // expanded already
+    };
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    vector<Record> records(1, { p->getInitial(), 0, 0, 0, false });
+    unordered_map<State, size_t, StateHash> index;   // canonical state -> record
+    vector<vector<pair<size_t, size_t>>> open;       // open[f]: (record, g) entries
+    size_t f = guided ? p->heuristic(p->getInitial()) : 0,
+           goal = SIZE_MAX;
+
+    index[p->canonical(p->getInitial())] = 0;
+    open.resize(f + 1);
+    open[f].push_back({ 0, 0 });
+
+    for(; f < open.size() && goal == SIZE_MAX; f++)
+        while(!open[f].empty())
+        {
+            pair<size_t, size_t> e = open[f].back();
+            open[f].pop_back();
+            if(records[e.first].closed || records[e.first].g != e.second)
+                continue;
+            if(p->goal_test(records[e.first].state))
+            {
+                goal = e.first;
+                break;
+            }
+            records[e.first].closed = true;
+            st.expanded++;
+
+            State state = records[e.first].state;
+            for(Action a : p->actions(state))
+            {
+                State child = p->result(state, a);
+                size_t g = e.second + p->cost(state, a);
+                st.generated++;
+
+                auto at = index.find(p->canonical(child));
+                size_t i;
+                if(at == index.end())
+                {
+                    i = records.size();
+                    index[p->canonical(child)] = i;
+                    records.push_back({ child, a, e.first, g, false });
+                }
+                else
+                {
+                    i = at->second;
+                    if(records[i].closed || records[i].g <= g)
+                        continue;
+                    records[i] = { child, a, e.first, g, false };
+                }
+
+                // an inconsistent heuristic may put f below the current
+                // bucket; the entry is then taken from this one
+                size_t fc = max(f, g + (guided ? p->heuristic(child) : 0));
+                if(fc >= open.size())
+                    open.resize(fc + 1);
+                open[fc].push_back({ i, g });
+            }
+        }
+    st.stored = records.size();
+    st.bytes = records.capacity() * sizeof(Record)
+             + index.size() * (sizeof(State) + sizeof(size_t) + 2 * sizeof(void*));
+
+    deque<Action> solution;
+    if(goal == SIZE_MAX)
+        return solution;
+    for(size_t i = goal; i != 0; i = records[i].parent)
+        solution.push_front(records[i].action);
+    return solution;
+}
+
+// settings for deepeningSearch() and parallelDeepening()
+struct DeepeningConfig
+{
+    bool heuristic = false;        // IDA*: bound g + heuristic() instead of g
+    size_t table = 1 << 16;        // transposition table slots, 0 for none
+};
+
+// the depth first search under a bound that iterative deepening repeats:
+// it cuts off paths whose g (or g + h) exceeds the bound and records the
+// smallest value cut off as the next bound. memory is the current path
+// plus a direct mapped transposition table of fixed size, whatever the
+// size of the state space. a child that undoes the previous action is
+// skipped, as is one already on the path, and a state the table saw
+// earlier in the same iteration at no greater depth is not searched
+// again: that visit had at least as much of the bound left and failed.
+// children are tried in action order.
+class DeepeningWorker
+{
+    public:
+    // a subtree handed out by parallelDeepening()
+    struct Unit
+    {
+        State state;               // root of the subtree
+        size_t g;                  // its depth
+        deque<Action> path;        // actions from the initial state
+        vector<State> onPath;      // canonical states before it
+    };
+    private:
+    struct Entry
+    {
+        State state;               // canonical state
+        size_t g,                  // depth it was searched at
+               round;              // iteration that stored it, 0 if empty
+    };
+
+    Problem* prob;
+    bool useHeuristic;
+    vector<Entry> table;           // size a power of 2, or empty
+    size_t round;                  // current iteration
+    StateHash hash;
+    public:
+    deque<Action> path;            // actions to the state being searched
+    vector<State> onPath;          // canonical states on the path
+    size_t bound,                  // largest g (or g + h) searched
+           next,                   // smallest g (or g + h) cut off
+           expanded,
+           generated,
+           used;                   // table slots filled this iteration
+    vector<Unit>* units;           // if set, subtrees at splitDepth are
+    size_t splitDepth;             // collected here instead of searched
+    const atomic<size_t>* winner;  // if set, stop once below unit
+    size_t unit;
+
+    DeepeningWorker(Problem*, const DeepeningConfig&);
+
+    // starts an iteration with the given bound.
+    void start(size_t);
+    // true once the goal is found from a state reached in g actions,
+    // leaving the actions in path.
+    bool search(State, size_t);
+
+    size_t estimate(State s) const { return useHeuristic ? prob->heuristic(s) : 0; }
+    size_t bytes() const { return table.size() * sizeof(Entry); }
+};
+
+DeepeningWorker::DeepeningWorker(Problem* p, const DeepeningConfig& cfg)
+    : prob(p), useHeuristic(cfg.heuristic),
+      table(cfg.table ? size_t(1) << bitsFor(cfg.table - 1) : 0, Entry{ 0, 0, 0 }),
+      round(0), bound(0), next(SIZE_MAX), expanded(0), generated(0), used(0),
+      units(nullptr), splitDepth(0), winner(nullptr), unit(0)
+{
+}
+
+void DeepeningWorker::start(size_t b)
+{
+    round++;
+    bound = b;
+    next = SIZE_MAX;
+    used = 0;
+}
+
+bool DeepeningWorker::search(State s, size_t g)
+{
+    size_t f = g + estimate(s);
+    if(f > bound)
+    {
+        next = min(next, f);
+        return false;
+    }
+    if(units && g == splitDepth)
+    {
+        units->push_back({ s, g, path, onPath });
+        return false;
+    }
+    if(prob->goal_test(s))
+        return true;
+    if(winner && *winner < unit)
+        return false;
+
+    State key = prob->canonical(s);
+    if(!table.empty())
+    {
+        Entry& e = table[hash(key) & (table.size() - 1)];
+        if(e.round == round && e.state == key && e.g <= g)
+            return false;
+        used += e.round != round;
+        e = { key, g, round };
+    }
+    expanded++;
+    onPath.push_back(key);
+    for(Action a : prob->actions(s))
+    {
+        State child = prob->result(s, a);
+        generated++;
+        State c = prob->canonical(child);
+        // undoing the previous action is the common cycle, so it is
+        // checked before the rest of the path
+        if(onPath.size() > 1 && c == onPath[onPath.size() - 2])
+            continue;
+        if(find(onPath.begin(), onPath.end(), c) != onPath.end())
+            continue;
+        path.push_back(a);
+        if(search(child, g + 1))
+            return true;
+        path.pop_back();
+    }
+    onPath.pop_back();
+    return false;
+}
+
+// iterative deepening depth first search, or IDA* with cfg.heuristic:
+// DeepeningWorker searches with a bound that rises to the smallest value
+// cut off, until the goal is found or nothing was cut off. the first path
+// found is the one BFS() returns.
+deque<Action> deepeningSearch(Problem* p, const DeepeningConfig& cfg, SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    DeepeningWorker w(p, cfg);
+    bool found = false;
+
+    for(size_t bound = w.estimate(p->getInitial()); ; bound = w.next)
+    {
+        w.start(bound);
+        found = w.search(p->getInitial(), 0);
+        // nothing was cut off, so no path of any length exists
+        if(found || w.next == SIZE_MAX)
+            break;
+    }
+    st.expanded = w.expanded;
+    st.generated = w.generated;
+    st.stored = w.used;
+    st.bytes = w.bytes();
+    return found ? w.path : deque<Action>();
+}
+
+// iterative deepening on a thread pool. each iteration first searches
+// the tree down to a shallow split depth, deep enough for about 16
+// subtrees per thread, collecting the subtrees there in depth first
+// order. one DeepeningWorker per thread, each with its own table, then
+// takes subtrees in that order. a worker finding the goal cancels the
+// subtrees after its own, but earlier ones run on, and the earliest
+// success wins, so the path is the one deepeningSearch() finds.
+deque<Action> parallelDeepening(Problem* p, const DeepeningConfig& cfg, unsigned threads = 0,
+                                SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    ThreadPool pool(threads);
+    DeepeningConfig splitCfg = cfg;
+    splitCfg.table = 0;
+    DeepeningWorker splitter(p, splitCfg);
+    vector<unique_ptr<DeepeningWorker>> workers;
+    for(unsigned i = 0; i < pool.size(); i++)
+        workers.push_back(make_unique<DeepeningWorker>(p, cfg));
+    vector<DeepeningWorker::Unit> units;
+    deque<Action> solution;
+    bool found = false;
+    size_t unitBytes = 0;
+
+    for(size_t bound = splitter.estimate(p->getInitial()); ; )
+    {
+        // split one level deeper until there are enough subtrees
+        splitter.units = &units;
+        for(splitter.splitDepth = 1; ; splitter.splitDepth++)
+        {
+            units.clear();
+            splitter.start(bound);
+            found = splitter.search(p->getInitial(), 0);
+            if(found || units.empty() || units.size() >= 16 * pool.size()
+                || splitter.splitDepth >= bound)
+                break;
+        }
+        if(found)
+        {
+            solution = splitter.path;
+            break;
+        }
+        size_t bytes = units.capacity() * sizeof(DeepeningWorker::Unit);
+        for(const DeepeningWorker::Unit& u : units)
+            bytes += u.path.size() * sizeof(Action) + u.onPath.size() * sizeof(State);
+        unitBytes = max(unitBytes, bytes);
+
+        atomic<size_t> winner(SIZE_MAX), taken(0);
+        mutex mtx;
+        vector<future<void>> runs;
+        for(unique_ptr<DeepeningWorker>& w : workers)
+            runs.push_back(pool.submit([&, w = w.get()]()
+            {
+                w->start(bound);
+                w->winner = &winner;
+                for(size_t u; (u = taken++) < units.size() && u < winner; )
+                {
+                    w->unit = u;
+                    w->path = units[u].path;
+                    w->onPath = units[u].onPath;
+                    if(w->search(units[u].state, units[u].g))
+                    {
+                        lock_guard<mutex> hold(mtx);
+                        if(u < winner)
+                        {
+                            winner = u;
+                            solution = w->path;
+                        }
+                    }
+                }
+            }));
+        for(future<void>& r : runs)
+            r.get();
+
+        found = winner != SIZE_MAX;
+        size_t next = splitter.next;
+        for(unique_ptr<DeepeningWorker>& w : workers)
+            next = min(next, w->next);
+        // nothing was cut off, so no path of any length exists
+        if(found || next == SIZE_MAX)
+            break;
+        bound = next;
+    }
+
+    st.expanded = splitter.expanded;
+    st.generated = splitter.generated;
+    st.bytes = unitBytes;
+    for(unique_ptr<DeepeningWorker>& w : workers)
+    {
+        st.expanded += w->expanded;
+        st.generated += w->generated;
+        st.stored += w->used;
+        st.bytes += w->bytes();
+    }
+    return found ? solution : deque<Action>();
+}
+
+// an unsigned integer of any size, for path counts that outgrow 64 bits.
+// the low word is kept inline, so small counts need no allocation.
+class PathCount
+{
+    private:
+    uint64_t low;                  // bits 0..63
+    vector<uint64_t> high;         // the words above, least significant first
+    public:
+
+    PathCount(uint64_t v = 0) : low(v) {}
+
+    PathCount& operator+=(const PathCount&);
+    // returns the count in decimal.
+    string str() const;
+};
+
+PathCount& PathCount::operator+=(const PathCount& o)
+{
+    if(high.size() < o.high.size())
+        high.resize(o.high.size(), 0);
+    bool carry = __builtin_add_overflow(low, o.low, &low);
+    for(size_t i = 0; i < high.size() && (carry || i < o.high.size()); i++)
+    {
+        bool c1 = __builtin_add_overflow(high[i], i < o.high.size() ? o.high[i] : 0, &high[i]);
+        bool c2 = __builtin_add_overflow(high[i], uint64_t(carry), &high[i]);
+        carry = c1 || c2;
+    }
+    if(carry)
+        high.push_back(1);
+    return *this;
+}
+
+string PathCount::str() const
+{
+    // divide by 10^19 repeatedly, collecting 19 digit chunks
+    const uint64_t chunk = 10000000000000000000ull;
+    vector<uint64_t> words(1, low);
+    words.insert(words.end(), high.begin(), high.end());
+    vector<uint64_t> parts;
+    while(words.size() > 1 || words[0] >= chunk)
+    {
+        unsigned __int128 rem = 0;
+        for(size_t i = words.size(); i-- > 0; )
+        {
+            unsigned __int128 cur = rem << 64 | words[i];
+            words[i] = uint64_t(cur / chunk);
+            rem = cur % chunk;
+        }
+        parts.push_back(uint64_t(rem));
+        while(words.size() > 1 && words.back() == 0)
+            words.pop_back();
+    }
+    string text = to_string(words[0]);
+    for(size_t i = parts.size(); i-- > 0; )
+    {
+        string digits = to_string(parts[i]);
+        text += string(19 - digits.size(), '0') + digits;
+    }
+    return text;
+}
+
+// counts the distinct shortest action sequences from the initial state
+// to the goal in one level synchronous pass, without storing any path:
+// a state's count is the sum of the counts of the states one level
+// shallower that have an action leading to it. each level is a sorted
+// array of (state, count), built by sorting the successors of the level
+// before and summing the counts of equal states. the search runs on the
+// concrete states, since symmetric states each carry their own paths.
+// sets length to the number of actions of those sequences; the count is
+// 0 if the goal is unreachable.
+PathCount countShortestPaths(Problem* p, size_t& length, SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    FlatHashSet<State> seen;
+    vector<pair<State, PathCount>> level(1, { p->getInitial(), PathCount(1) }),
+                                   next;
+    seen.insert(p->getInitial());
+    length = 0;
+
+    while(!level.empty())
+    {
+        for(const pair<State, PathCount>& s : level)
+            if(p->goal_test(s.first))
+            {
+                st.stored = seen.size();
+                return s.second;
+            }
+
+        next.clear();
+        for(const pair<State, PathCount>& s : level)
+        {
+            st.expanded++;
+            for(Action a : p->actions(s.first))
+            {
+                State child = p->result(s.first, a);
+                st.generated++;
+                if(!seen.contains(child))
+                    next.push_back({ child, s.second });
+            }
+        }
+        sort(next.begin(), next.end(),
+             [](const pair<State, PathCount>& a, const pair<State, PathCount>& b)
+             { return a.first < b.first; });
+
+        // merge the runs of equal states, summing their counts
+        size_t kept = 0;
+        for(size_t i = 0; i < next.size(); kept++)
+        {
+            size_t j = i + 1;
+            for(; j < next.size() && next[j].first == next[i].first; j++)
+                next[i].second += next[j].second;
+            seen.insert(next[i].first);
+            if(kept != i)
+                next[kept] = move(next[i]);
+            i = j;
+        }
+        next.resize(kept);
+        st.bytes = max(st.bytes, seen.bytes() + (level.capacity() + next.capacity())
+                                                * sizeof(pair<State, PathCount>));
+        level.swap(next);
+        length++;
+    }
+    st.stored = seen.size();
+    length = 0;
+    return PathCount();
+}
+
+// a sequence of values computed on demand by a coroutine that co_yields
+// them one at a time. the coroutine runs only as far as the values taken
+// so far, and a yielded value is valid until the iterator moves on.
+template<class T>
+class Generator
+{
+    public:
+    struct promise_type
+    {
+        const T* value = nullptr;  // the value last yielded
+
+        Generator get_return_object()
+        {
+            return Generator(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_always final_suspend() noexcept { return {}; }
+        suspend_always yield_value(const T& v) noexcept
+        {
+            value = &v;
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { throw; }
+    };
+
+    class iterator
+    {
+        private:
+        coroutine_handle<promise_type> co;
+        public:
+
+        explicit iterator(coroutine_handle<promise_type> co) : co(co) {}
+
+        const T& operator*() const { return *co.promise().value; }
+        iterator& operator++()
+        {
+            co.resume();
+            return *this;
+        }
+        bool operator==(default_sentinel_t) const { return co.done(); }
+    };
+
+    Generator(Generator&& g) : co(exchange(g.co, nullptr)) {}
+    ~Generator()
+    {
+        if(co)
+            co.destroy();
+    }
+
+    // runs the coroutine up to its first value.
+    iterator begin()
+    {
+        co.resume();
+        return iterator(co);
+    }
+    default_sentinel_t end() const { return default_sentinel; }
+
+    private:
+    coroutine_handle<promise_type> co;
+
+    explicit Generator(coroutine_handle<promise_type> co) : co(co) {}
+};
+
+// yields every shortest action sequence from the initial state to the
+// goal, one at a time. a level synchronous pass over the concrete states
+// first builds the layered DAG of shortest paths: each state of a level
+// keeps the (parent index, action) edges from its parents one level up,
+// as one edge array per level indexed by offsets. the solutions are then
+// walked lazily backwards from the goal, following one edge per level.
+// every DAG state has a parent, so no walk dead ends, and memory is the
+// DAG plus one path however many solutions there are.
+Generator<deque<Action>> shortestSolutions(Problem* p)
+{
+    struct Layer
+    {
+        vector<State> states;                  // sorted states of the level
+        vector<size_t> first;                  // first[i]: first parent edge of states[i]
+        vector<pair<size_t, Action>> parents;  // (index in the level above, action)
+    };
+    struct Edge
+    {
+        State child;
+        size_t parent;
+        Action action;
+
+        bool operator<(const Edge& e) const
+        {
+            return child != e.child ? child < e.child : parent < e.parent;
+        }
+    };
+    FlatHashSet<State> seen;
+    vector<Layer> dag(1);
+    vector<Edge> next;
+    dag[0].states.push_back(p->getInitial());
+    seen.insert(p->getInitial());
+
+    size_t goal = SIZE_MAX;
+    while(goal == SIZE_MAX)
+    {
+        const vector<State>& level = dag.back().states;
+        for(size_t i = 0; i < level.size() && goal == SIZE_MAX; i++)
+            if(p->goal_test(level[i]))
+                goal = i;
+        if(goal != SIZE_MAX)
+            break;
+
+        next.clear();
+        for(size_t i = 0; i < level.size(); i++)
+            for(Action a : p->actions(level[i]))
+            {
+                State child = p->result(level[i], a);
+                if(!seen.contains(child))
+                    next.push_back({ child, i, a });
+            }
+        if(next.empty())
+            co_return;
+        stable_sort(next.begin(), next.end());
+
+        Layer layer;
+        for(const Edge& e : next)
+        {
+            if(layer.states.empty() || layer.states.back() != e.child)
+            {
+                layer.states.push_back(e.child);
+                layer.first.push_back(layer.parents.size());
+                seen.insert(e.child);
+            }
+            layer.parents.push_back({ e.parent, e.action });
+        }
+        layer.first.push_back(layer.parents.size());
+        dag.push_back(move(layer));
+    }
+
+    size_t depth = dag.size() - 1;
+    deque<Action> path(depth);
+    if(depth == 0)
+    {
+        co_yield path;
+        co_return;
+    }
+
+    // at[d]: index in level d of the path's state there; edge[d]: the
+    // parent edge of that state the path follows up to level d - 1
+    vector<size_t> at(depth + 1), edge(depth + 1);
+    at[depth] = goal;
+    edge[depth] = dag[depth].first[goal];
+    for(size_t d = depth; ; )
+    {
+        if(d == 0)
+        {
+            co_yield path;
+            edge[++d]++;
+        }
+        else if(edge[d] == dag[d].first[at[d] + 1])
+        {
+            // every parent of this state is done, so back out a level
+            if(d == depth)
+                co_return;
+            edge[++d]++;
+        }
+        else
+        {
+            const pair<size_t, Action>& e = dag[d].parents[edge[d]];
+            path[d - 1] = e.second;
+            at[d - 1] = e.first;
+            if(--d > 0)
+                edge[d] = dag[d].first[at[d]];
+        }
+    }
+}
+
+// solves many instances that share a problem and its goal with one
+// search: a BFS from the goal until every source has been reached. the
+// problem must be reversible, so the path from a source walks the BFS
+// tree back to the goal, taking at each state the action that leads to
+// its tree parent. the paths are shortest, but where several are, not
+// necessarily the one BFS() picks. an unreachable source gets no actions.
+vector<deque<Action>> multiSourceBFS(Problem* p, const vector<State>& sources,
+                                     SearchStats* stats = nullptr)
+{
+    SearchStats local;
+    SearchStats& st = stats ? *stats : local;
+    unordered_map<State, State, StateHash> parent;   // tree parent, toward the goal
+    FlatHashSet<State> wanted;
+    for(State s : sources)
+        wanted.insert(s);
+    vector<State> level(1, p->getGoal()), next;
+    parent[p->getGoal()] = p->getGoal();
+    size_t left = wanted.size() - wanted.contains(p->getGoal());
+
+    while(left && !level.empty())
+    {
+        next.clear();
+        for(State s : level)
+        {
+            st.expanded++;
+            for(Action a : p->actions(s))
+            {
+                State child = p->result(s, a);
+                st.generated++;
+                if(parent.emplace(child, s).second)
+                {
+                    next.push_back(child);
+                    left -= wanted.contains(child);
+                }
+            }
+        }
+        level.swap(next);
+    }
+    st.stored = parent.size();
+
+    vector<deque<Action>> paths(sources.size());
+    for(size_t i = 0; i < sources.size(); i++)
+    {
+        if(!parent.count(sources[i]))
+            continue;
+        for(State x = sources[i]; x != p->getGoal(); x = parent[x])
+            for(Action a : p->actions(x))
+                if(p->result(x, a) == parent[x])
+                {
+                    paths[i].push_back(a);
+                    break;
+                }
+    }
+    return paths;
+}
+
+// one (initial, goal) pair to solve
+struct Instance
+{
+    State initial,
+          goal;
+};
+
+// reads instances from a stream, either as whitespace separated text
+// pairs ("195 60" or "0xC3 0x3C", '#' starts a comment) or as a binary
+// stream of LEB128 varints, initial then goal.
+class InstanceReader
+{
+    private:
+    FILE* in;                        // source stream
+    bool binary;                     // true for the varint format
+    vector<char> buf;                // bytes read but not yet parsed
+    size_t pos,                      // next unparsed byte in buf
+           len,                      // number of valid bytes in buf
+           consumed,                 // bytes of the stream before buf
+           line,                     // line of the next byte, from 1
+           last;                     // line or offset of the last initial state
+    string err;                      // why reading stopped early, if it did
+
+    int get();
+    int peek();
+    bool fail(const char* what, size_t at);
+    bool textNumber(State&, bool first);
+    bool varint(State&, bool first);
+    public:
+
+    InstanceReader(FILE* in, bool binary)
+        : in(in), binary(binary), buf(1 << 16), pos(0), len(0), consumed(0),
+          line(1), last(0) {}
+
+    // appends up to max instances to batch, returns the number read.
+    // reading stops at the end of the input or at malformed input.
+    size_t read(vector<Instance>& batch, size_t max);
+
+    // returns what was malformed, with its line or byte offset, or "" if
+    // the input was read to its end.
+    const string& error() const { return err; }
+};
+
+int InstanceReader::peek()
+{
+    if(pos == len)
+    {
+        consumed += len;
+        len = fread(buf.data(), 1, buf.size(), in);
+        pos = 0;
+        if(len == 0)
+            return EOF;
+    }
+    return (unsigned char)buf[pos];
+}
+
+int InstanceReader::get()
+{
+    int c = peek();
+    if(c != EOF)
+        pos++;
+    if(c == '\n')
+        line++;
+    return c;
+}
+
+bool InstanceReader::fail(const char* what, size_t at)
+{
+    err = string(what) + (binary ? " at byte " : " on line ") + to_string(at);
+    return false;
+}
+
+bool InstanceReader::textNumber(State& v, bool first)
+{
+    int c = get();
+    for(;;)
+    {
+        while(c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',')
+            c = get();
+        if(c != '#')
+            break;
+        while(c != '\n' && c != EOF)
+            c = get();
+    }
+    size_t at = line;
+    if(c == EOF)
+        return first ? false : fail("instance without a goal", last);
+    if(first)
+        last = at;
+
+    int base = 10;
+    if(c == '0' && (peek() == 'x' || peek() == 'X'))
+    {
+        get();
+        c = get();
+        base = 16;
+    }
+    v = 0;
+    size_t digits = 0;
+    for(;; c = get(), digits++)
+    {
+        int d;
+        if(c >= '0' && c <= '9')
+            d = c - '0';
+        else if(base == 16 && c >= 'a' && c <= 'f')
+            d = c - 'a' + 10;
+        else if(base == 16 && c >= 'A' && c <= 'F')
+            d = c - 'A' + 10;
+        else
+            break;
+        if(v > (numeric_limits<State>::max() - d) / base)
+            return fail("number too large for a state", at);
+        v = v * base + d;
+    }
+    // a number ends at a separator, a comment or the end of the input
+    bool ends = c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ','
+                || c == '#' || c == EOF;
+    if(digits == 0 || !ends)
+        return fail("malformed number", at);
+    // leave a comment for the next call to skip
+    if(c == '#')
+        pos--;
+    else if(c == '\n')
+    {
+        pos--;
+        line--;
+    }
+    return true;
+}
+
+bool InstanceReader::varint(State& v, bool first)
+{
+    size_t at = consumed + pos;
+    if(first)
+        last = at;
+    v = 0;
+    // 64 bits take at most 10 bytes, the last carrying a single bit
+    for(int i = 0; i < 10; i++)
+    {
+        int c = get();
+        if(c == EOF)
+        {
+            if(i == 0 && first)
+                return false;
+            return i == 0 ? fail("instance without a goal", last)
+                          : fail("truncated varint", at);
+        }
+        if(i == 9 && c > 1)
+            return fail("varint too large for a state", at);
+        v |= State(c & 0x7F) << (7 * i);
+        if(!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+size_t InstanceReader::read(vector<Instance>& batch, size_t max)
+{
+    size_t n = 0;
+    State initial, goal;
+    while(n < max && err.empty())
+    {
+        bool ok = binary ? varint(initial, true) && varint(goal, false)
+                         : textNumber(initial, true) && textNumber(goal, false);
+        if(!ok)
+            break;
+        batch.push_back({ initial, goal });
+        n++;
+    }
+    return n;
+}
+
+
+template<class Int>
+static void appendNumber(string& out, Int v)
+{
+    char tmp[24];
+    char* end = to_chars(tmp, tmp + sizeof tmp, v).ptr;
+    out.append(tmp, end);
+}
+
+static void appendVarint(string& out, unsigned long long v)
+{
+    while(v >= 0x80)
+    {
+        out += char(v | 0x80);
+        v >>= 7;
+    }
+    out += char(v);
+}
+
+// appends solutions to a caller supplied buffer in one output format.
+// encoders hold no per-call state and can be shared between threads.
+class SolutionEncoder
+{
+    public:
+    virtual ~SolutionEncoder() {}
+
+    // appends one instance's result; soln is empty and solved false when
+    // the goal is unreachable.
+    virtual void encode(string& out, const Instance& in,
+                        const deque<Action>& soln, bool solved) const = 0;
+};
+
+// "initial goal length action..." per line, length -1 if unsolvable
+class CodesEncoder : public SolutionEncoder
+{
+    public:
+    virtual void encode(string&, const Instance&, const deque<Action>&, bool) const;
+};
+
+void CodesEncoder::encode(string& out, const Instance& in,
+                          const deque<Action>& soln, bool solved) const
+{
+    appendNumber(out, in.initial);
+    out += ' ';
+    appendNumber(out, in.goal);
+    out += ' ';
+    appendNumber(out, solved ? (long long)soln.size() : -1);
+    for(Action action : soln)
+    {
+        out += ' ';
+        appendNumber(out, action);
+    }
+    out += '\n';
+}
+
+// one English sentence per action, optionally below an instance header
+class TextEncoder : public SolutionEncoder
+{
+    private:
+    string sentence[256];            // output line for each action code
+    bool headers;                    // print "initial -> goal:" first
+    public:
+
+    TextEncoder(bool headers = true);
+    virtual void encode(string&, const Instance&, const deque<Action>&, bool) const;
+};
+
+TextEncoder::TextEncoder(bool headers) : headers(headers)
+{
+    sentence[RP]      = "Peasant crosses right.\n";
+    sentence[RP|RC]   = "Peasant and cabbage crosses right.\n";
+    sentence[RP|RG]   = "Peasant and goat crosses right.\n";
+    sentence[RP|RW]   = "Peasant and wolf crosses right.\n";
+    sentence[LP]      = "Peasant crosses left.\n";
+    sentence[LP|LC]   = "Peasant and cabbage crosses left.\n";
+    sentence[LP|LG]   = "Peasant and goat crosses left.\n";
+    sentence[LP|LW]   = "Peasant and wolf crosses left.\n";
+}
+
+void TextEncoder::encode(string& out, const Instance& in,
+                         const deque<Action>& soln, bool solved) const
+{
+    if(headers)
+    {
+        appendNumber(out, in.initial);
+        out += " -> ";
+        appendNumber(out, in.goal);
+        out += solved ? ":\n" : ": no solution\n";
+    }
+    for(Action action : soln)
+        out += sentence[action & 0xFF];
+}
+
+// one JSON object per line:
+// {"initial":15,"goal":240,"solved":true,"actions":[160,8]}
+class JsonEncoder : public SolutionEncoder
+{
+    public:
+    virtual void encode(string&, const Instance&, const deque<Action>&, bool) const;
+};
+
+void JsonEncoder::encode(string& out, const Instance& in,
+                         const deque<Action>& soln, bool solved) const
+{
+    out += "{\"initial\":";
+    appendNumber(out, in.initial);
+    out += ",\"goal\":";
+    appendNumber(out, in.goal);
+    out += solved ? ",\"solved\":true,\"actions\":[" : ",\"solved\":false,\"actions\":[";
+    for(size_t i = 0; i < soln.size(); i++)
+    {
+        if(i)
+            out += ',';
+        appendNumber(out, soln[i]);
+    }
+    out += "]}\n";
+}
+
+// per instance: varint initial, varint goal, varint (length + 1) or 0 if
+// unsolvable, then one byte per action holding its action code.
+class BinaryEncoder : public SolutionEncoder
+{
+    public:
+    virtual void encode(string&, const Instance&, const deque<Action>&, bool) const;
+};
+
+void BinaryEncoder::encode(string& out, const Instance& in,
+                           const deque<Action>& soln, bool solved) const
+{
+    appendVarint(out, in.initial);
+    appendVarint(out, in.goal);
+    appendVarint(out, solved ? soln.size() + 1 : 0);
+    for(Action action : soln)
+        out += char(action);
+}
+
+// returns the encoder for a format name, or nullptr if unknown.
+unique_ptr<SolutionEncoder> makeEncoder(const string& format)
+{
+    if(format == "codes")
+        return make_unique<CodesEncoder>();
+    if(format == "text")
+        return make_unique<TextEncoder>();
+    if(format == "json")
+        return make_unique<JsonEncoder>();
+    if(format == "binary")
+        return make_unique<BinaryEncoder>();
+    return nullptr;
+}
+
+
+// appends v as 8 little-endian bytes.
+static void appendWord(string& out, uint64_t v)
+{
+    for(int i = 0; i < 8; i++)
+        out += char(v >> 8 * i);
+}
+
+// writes the graph of the states reachable from the initial state to a
+// binary file, all words 64-bit little-endian:
+//   header   "BFSGRAPH", then version (1), states n, edges m, initial and
+//            goal state numbers (goal ~0 if unreachable), and the byte
+//            positions of the four sections below
+//   table    the n states, sorted; a state's number is its position
+//   offsets  n + 1 positions; state i's edges are offsets[i] to offsets[i + 1]
+//   targets  m state numbers
+//   actions  m actions, the label of each edge
+// states are canonical ones. a first pass finds them, a level at a time
+// on the pool; a second pass expands them again in chunks on the pool,
+// and the chunks are streamed to the three edge sections in order, so
+// only the state table is held in memory. returns false if writing
+// failed.
+bool exportGraph(Problem* p, const string& file, unsigned threads, size_t& states, size_t& edges)
+{
+    ThreadPool pool(threads);
+    vector<State> table, level(1, p->canonical(p->getInitial()));
+    atomic<size_t> edgeCount(0);
+    {
+        ConcurrentStateSet seen;
+        seen.insert(level[0]);
+        while(!level.empty())
+        {
+            table.insert(table.end(), level.begin(), level.end());
+            size_t slices = min(level.size(), size_t(pool.size()) * 4),
+                   per = (level.size() + slices - 1) / slices;
+            vector<future<vector<State>>> parts;
+            for(size_t from = 0; from < level.size(); from += per)
+                parts.push_back(pool.submit([&, from]()
+                {
+                    vector<State> out;
+                    size_t to = min(level.size(), from + per), gen = 0;
+                    for(size_t i = from; i < to; i++)
+                        for(Action a : p->actions(level[i]))
+                        {
+                            State child = p->canonical(p->result(level[i], a));
+                            gen++;
+                            if(seen.insert(child))
+                                out.push_back(child);
+                        }
+                    edgeCount += gen;
+                    return out;
+                }));
+            vector<State> next;
+            for(future<vector<State>>& f : parts)
+            {
+                vector<State> out = f.get();
+                next.insert(next.end(), out.begin(), out.end());
+            }
+            level.swap(next);
+        }
+    }
+    sort(table.begin(), table.end());
+    states = table.size();
+    edges = edgeCount;
+
+    auto number = [&table](State s) -> uint64_t
+    {
+        auto it = lower_bound(table.begin(), table.end(), s);
+        return it != table.end() && *it == s ? it - table.begin() : ~uint64_t(0);
+    };
+    uint64_t tableAt = 80, offsetsAt = tableAt + 8 * states,
+             targetsAt = offsetsAt + 8 * (states + 1), actionsAt = targetsAt + 8 * edges;
+
+    // the header and table, then one stream per edge section
+    FILE* out = fopen(file.c_str(), "w+b");
+    if(!out)
+        return false;
+    FILE* targetsOut = fopen(file.c_str(), "r+b");
+    FILE* actionsOut = fopen(file.c_str(), "r+b");
+    bool ok = targetsOut && actionsOut && fseeko(targetsOut, targetsAt, SEEK_SET) == 0
+                                       && fseeko(actionsOut, actionsAt, SEEK_SET) == 0;
+    if(ok)
+    {
+        BufferedWriter offsetsW(out), targetsW(targetsOut), actionsW(actionsOut);
+        string buf = "BFSGRAPH";
+        for(uint64_t v : { uint64_t(1), uint64_t(states), uint64_t(edges),
+                           number(p->canonical(p->getInitial())), number(p->canonical(p->getGoal())),
+                           tableAt, offsetsAt, targetsAt, actionsAt })
+            appendWord(buf, v);
+        for(State s : table)
+        {
+            appendWord(buf, s);
+            if(buf.size() >= 1 << 16)
+            {
+                offsetsW.write(buf);
+                buf.clear();
+            }
+        }
+        offsetsW.write(buf);
+
+        // chunks of the second pass: their degrees, targets and actions
+        struct Chunk
+        {
+            vector<size_t> degree;
+            string targets, actions;
+        };
+        const size_t per = 4096;
+        BoundedQueue<future<Chunk>> pending(2 * pool.size() + 2);
+        uint64_t written = 0;
+        thread writer([&]()
+        {
+            string offs;
+            future<Chunk> f;
+            while(pending.pop(f))
+            {
+                Chunk c = f.get();
+                offs.clear();
+                for(size_t d : c.degree)
+                {
+                    appendWord(offs, written);
+                    written += d;
+                }
+                offsetsW.write(offs);
+                targetsW.write(c.targets);
+                actionsW.write(c.actions);
+            }
+        });
+        for(size_t from = 0; from < states; from += per)
+            pending.push(pool.submit([&, from]()
+            {
+                Chunk c;
+                for(size_t i = from; i < min(states, from + per); i++)
+                {
+                    deque<Action> acts = p->actions(table[i]);
+                    c.degree.push_back(acts.size());
+                    for(Action a : acts)
+                    {
+                        appendWord(c.targets, number(p->canonical(p->result(table[i], a))));
+                        appendWord(c.actions, a);
+                    }
+                }
+                return c;
+            }));
+        pending.close();
+        writer.join();
+        buf.clear();
+        appendWord(buf, written);
+        offsetsW.write(buf);
+        ok = written == edges;
+    }
+    for(FILE* f : { out, targetsOut, actionsOut })
+        if(f)
+        {
+            ok = ok && !ferror(f);
+            ok = fclose(f) == 0 && ok;
+        }
+    return ok;
+}
+
+// counters of a SuccessorCache
+struct SuccessorStats
+{
+    size_t states = 0,             // states whose successors are held
+           edges = 0,              // successors held
+           bytes = 0,              // memory held, estimated
+           hits = 0,               // lookups answered from the cache
+           misses = 0,             // states expanded by the problem
+           evicted = 0;            // states dropped to stay under the limit
+};
+
+// memoizes a problem's actions() and result(): the first time a state is
+// looked up, all its actions and their resulting states are computed and
+// kept, so later lookups, by this or any later search of the same rules,
+// cost a hash lookup. rows are kept in compressed sparse row form, in
+// two generations that share the memory limit: new rows go to the young
+// one, and when it fills up the old one is dropped and the young one
+// takes its place. a row found in the old generation is copied back into
+// the young one, so the rows in use survive. each row also keeps its
+// edges' order by action, so result() finds an action by binary search
+// rather than a scan of the row. safe to share between threads if the
+// problem's own actions() and result() are.
+class SuccessorCache
+{
+    private:
+    struct Generation
+    {
+        unordered_map<State, size_t, StateHash> row;   // state -> row number
+        vector<size_t> begin;      // row r's edges are begin[r] to begin[r + 1]
+        vector<Action> actions;    // edge labels
+        vector<State> targets;     // edge targets
+        vector<uint32_t> order;    // a row's edge offsets, sorted by action
+
+        Generation() : begin(1, 0) {}
+        size_t bytes() const;
+    };
+
+    Problem* prob;
+    size_t limit;                  // bytes in all, 0 for no limit
+    Generation young, old;
+    shared_mutex mtx;
+    atomic<size_t> hits, misses, evicted;
+
+    template<class Visit> void with(State, Visit);
+    void load(State, vector<Action>&, vector<State>&, vector<uint32_t>&);
+    void add(State, const vector<Action>&, const vector<State>&, const vector<uint32_t>&);
+    public:
+
+    // caches the successors of the problem's states in up to limit bytes,
+    // or without limit if 0.
+    SuccessorCache(Problem*, size_t limit = 0);
+
+    deque<Action> actions(State);
+    State result(State, Action);
+    // expands every state reachable from the given one. returns false if
+    // they did not all fit within the limit.
+    bool materialize(State);
+
+    SuccessorStats stats();
+};
+
+size_t SuccessorCache::Generation::bytes() const
+{
+    return row.size() * (sizeof(pair<State, size_t>) + 2 * sizeof(void*))
+         + row.bucket_count() * sizeof(void*) + begin.capacity() * sizeof(size_t)
+         + actions.capacity() * sizeof(Action) + targets.capacity() * sizeof(State)
+         + order.capacity() * sizeof(uint32_t);
+}
+
+SuccessorCache::SuccessorCache(Problem* p, size_t limit)
+    : prob(p), limit(limit), hits(0), misses(0), evicted(0) {}
+
+// calls visit(actions, targets, order, n) on the successors of s. a row
+// of the young generation is visited in place, under the shared lock.
+template<class Visit>
+void SuccessorCache::with(State s, Visit visit)
+{
+    {
+        shared_lock<shared_mutex> hold(mtx);
+        auto it = young.row.find(s);
+        if(it != young.row.end())
+        {
+            size_t from = young.begin[it->second], to = young.begin[it->second + 1];
+            hits++;
+            visit(young.actions.data() + from, young.targets.data() + from,
+                  young.order.data() + from, to - from);
+            return;
+        }
+    }
+    vector<Action> acts;
+    vector<State> next;
+    vector<uint32_t> order;
+    load(s, acts, next, order);
+    visit(acts.data(), next.data(), order.data(), acts.size());
+}
+
+// fills acts, next and order with the successors of s, taken from the
+// old generation or computed, and adds them to the young one.
+void SuccessorCache::load(State s, vector<Action>& acts, vector<State>& next,
+                          vector<uint32_t>& order)
+{
+    bool promote = false;
+    {
+        shared_lock<shared_mutex> hold(mtx);
+        auto it = old.row.find(s);
+        if(it != old.row.end())
+        {
+            size_t from = old.begin[it->second], to = old.begin[it->second + 1];
+            acts.assign(old.actions.begin() + from, old.actions.begin() + to);
+            next.assign(old.targets.begin() + from, old.targets.begin() + to);
+            order.assign(old.order.begin() + from, old.order.begin() + to);
+            hits++;
+            promote = true;
+        }
+    }
+    if(!promote)
+    {
+        // expanded outside the lock; a racing thread may add it first
+        misses++;
+        acts.clear();
+        next.clear();
+        for(Action a : prob->actions(s))
+        {
+            acts.push_back(a);
+            next.push_back(prob->result(s, a));
+        }
+        order.resize(acts.size());
+        for(size_t i = 0; i < order.size(); i++)
+            order[i] = i;
+        stable_sort(order.begin(), order.end(),
+                    [&acts](uint32_t x, uint32_t y) { return acts[x] < acts[y]; });
+    }
+    add(s, acts, next, order);
+}
+
+// appends a row to the young generation, first aging the generations if
+// it holds half the limit.
+void SuccessorCache::add(State s, const vector<Action>& acts, const vector<State>& next,
+                         const vector<uint32_t>& order)
+{
+    unique_lock<shared_mutex> hold(mtx);
+    if(young.row.count(s))
+        return;
+    if(limit && young.bytes() > limit / 2 && !young.row.empty())
+    {
+        evicted += old.row.size();
+        old = move(young);
+        young = Generation();
+    }
+    young.row.emplace(s, young.begin.size() - 1);
+    young.actions.insert(young.actions.end(), acts.begin(), acts.end());
+    young.targets.insert(young.targets.end(), next.begin(), next.end());
+    young.order.insert(young.order.end(), order.begin(), order.end());
+    young.begin.push_back(young.actions.size());
+}
+
+deque<Action> SuccessorCache::actions(State s)
+{
+    deque<Action> acts;
+    with(s, [&acts](const Action* a, const State*, const uint32_t*, size_t n)
+    {
+        acts.assign(a, a + n);
+    });
+    return acts;
+}
+
+State SuccessorCache::result(State s, Action a)
+{
+    bool found = false;
+    State t = 0;
+    with(s, [&](const Action* acts, const State* next, const uint32_t* order, size_t n)
+    {
+        const uint32_t* at = lower_bound(order, order + n, a,
+                                         [acts](uint32_t i, Action x) { return acts[i] < x; });
+        if(at != order + n && acts[*at] == a)
+        {
+            t = next[*at];
+            found = true;
+        }
+    });
+    return found ? t : prob->result(s, a);
+}
+
+bool SuccessorCache::materialize(State from)
+{
+    size_t dropped = evicted;
+    FlatHashSet<State> seen;
+    vector<State> level(1, from), nextLevel;
+    seen.insert(from);
+    while(!level.empty())
+    {
+        nextLevel.clear();
+        for(State s : level)
+            with(s, [&](const Action*, const State* next, const uint32_t*, size_t n)
+            {
+                for(size_t i = 0; i < n; i++)
+                    if(seen.insert(next[i]))
+                        nextLevel.push_back(next[i]);
+            });
+        if(evicted != dropped)
+            return false;
+        level.swap(nextLevel);
+    }
+    return true;
+}
+
+SuccessorStats SuccessorCache::stats()
+{
+    shared_lock<shared_mutex> hold(mtx);
+    SuccessorStats st;
+    st.states = young.row.size() + old.row.size();
+    st.edges = young.actions.size() + old.actions.size();
+    st.bytes = young.bytes() + old.bytes();
+    st.hits = hits;
+    st.misses = misses;
+    st.evicted = evicted;
+    return st;
+}
+
+// a problem whose actions() and result() come from a SuccessorCache of
+// another problem's rules, with its own endpoints. every other question
+// goes to the other problem.
+class CachedProblem : public Problem
+{
+    private:
+    Problem* rules;
+    SuccessorCache* cache;
+    public:
+
+    CachedProblem(Problem* rules, SuccessorCache* cache, State initial, State goal)
+        : Problem(initial, goal), rules(rules), cache(cache) {}
+
+    virtual deque<Action> actions(State s) { return cache->actions(s); }
+    virtual State result(State s, Action a) { return cache->result(s, a); }
+    virtual State canonical(State s) const { return rules->canonical(s); }
+    virtual bool hasSymmetry() const { return rules->hasSymmetry(); }
+    virtual unique_ptr<StateRanking> ranking() { return rules->ranking(); }
+    virtual size_t maxActions() const { return rules->maxActions(); }
+    virtual bool reversible() const { return rules->reversible(); }
+    virtual size_t cost(State s, Action a) const { return rules->cost(s, a); }
+    virtual size_t heuristic(State s) const { return rules->heuristic(s); }
+    virtual uint64_t fingerprint() const { return rules->fingerprint(); }
+};
+
+// prints the counters of a successor cache on stderr.
+static void reportSuccessors(SuccessorCache& cache)
+{
+    SuccessorStats st = cache.stats();
+    fprintf(stderr, "successor cache: %zu states, %zu edges in %zu bytes, %zu evicted\n",
+            st.states, st.edges, st.bytes, st.evicted);
+    fprintf(stderr, "successor cache: %zu hits, %zu expansions\n", st.hits, st.misses);
+}
+
+// counters of a ResultCache
+struct CacheStats
+{
+    size_t hits = 0,               // lookups answered by a stored path
+           suffixHits = 0,         // of those, answered by the tail of a longer path
+           misses = 0,             // lookups not answered
+           inserts = 0,            // paths stored
+           evictions = 0,          // entries dropped to stay under the limit
+           entries = 0,            // entries held, paths and suffix links
+           bytes = 0;              // memory held by the entries, estimated
+};
+
+// a thread safe LRU cache of shortest paths, keyed by the fingerprint of
+// a problem's rules and the path's endpoints. every stored path also
+// leaves a small link entry for each state it passes through, so a later
+// request from such a state is answered by the path's suffix: any part
+// of a shortest path is a shortest path. keys are spread over shards,
+// each with its own lock, LRU list and share of the memory limit. links
+// are not updated when their path is evicted; a lookup that finds one
+// stale drops it.
+class ResultCache
+{
+    private:
+    struct Key
+    {
+        uint64_t rules;
+        State start,
+              goal;
+        bool operator==(const Key& o) const
+        {
+            return rules == o.rules && start == o.start && goal == o.goal;
+        }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& k) const
+        {
+            StateHash h;
+            return h(k.rules ^ h(k.start ^ h(k.goal)));
+        }
+    };
+    // a stored path, or a link to a path passing through key.start
+    struct Entry
+    {
+        Key key;
+        vector<State> states;      // the path's states, empty in a link
+        vector<Action> actions;    // the path's actions
+        Key owner;                 // a link's path
+        size_t offset;             // position of key.start in the link's path
+        size_t bytes;              // memory charged for this entry
+    };
+    struct Shard
+    {
+        mutex mtx;
+        list<Entry> lru;           // most recently used first
+        unordered_map<Key, list<Entry>::iterator, KeyHash> index;
+        size_t bytes = 0;
+    };
+
+    vector<Shard> shards;
+    size_t shardLimit;             // bytes each shard may hold
+    atomic<size_t> hits, suffixHits, misses, inserts, evictions;
+
+    Shard& shardOf(const Key& k) { return shards[KeyHash()(k) % shards.size()]; }
+    void put(Shard&, Entry&&);
+    void drop(Shard&, list<Entry>::iterator);
+    public:
+
+    // holds up to the given number of bytes of entries in all.
+    ResultCache(size_t bytes, unsigned shardCount = 16);
+
+    // looks up a shortest path from start to goal under the given rules.
+    // returns false on a miss; an empty path means no solution exists.
+    bool find(uint64_t rules, State start, State goal, deque<Action>& path);
+    // stores a shortest path, or an empty one if the problem is unsolvable.
+    // result() replays the path to find the states it passes through.
+    void insert(Problem*, State start, const deque<Action>& path);
+
+    CacheStats stats();
+};
+
+ResultCache::ResultCache(size_t bytes, unsigned shardCount)
+    : shards(max(1u, shardCount)), hits(0), suffixHits(0), misses(0),
+      inserts(0), evictions(0)
+{
+    shardLimit = bytes / shards.size();
+}
+
+// adds or replaces an entry, then evicts from the cold end of the shard
+// until it fits. the caller holds the shard's lock.
+void ResultCache::put(Shard& sh, Entry&& e)
+{
+    auto it = sh.index.find(e.key);
+    if(it != sh.index.end())
+        drop(sh, it->second);
+    sh.bytes += e.bytes;
+    sh.lru.push_front(move(e));
+    sh.index.emplace(sh.lru.front().key, sh.lru.begin());
+    while(sh.bytes > shardLimit && sh.lru.size() > 1)
+    {
+        drop(sh, prev(sh.lru.end()));
+        evictions++;
+    }
+}
+
+void ResultCache::drop(Shard& sh, list<Entry>::iterator it)
+{
+    sh.bytes -= it->bytes;
+    sh.index.erase(it->key);
+    sh.lru.erase(it);
+}
+
+bool ResultCache::find(uint64_t rules, State start, State goal, deque<Action>& path)
+{
+    Key key{ rules, start, goal }, owner;
+    size_t offset;
+    {
+        Shard& sh = shardOf(key);
+        lock_guard<mutex> hold(sh.mtx);
+        auto it = sh.index.find(key);
+        if(it == sh.index.end())
+        {
+            misses++;
+            return false;
+        }
+        sh.lru.splice(sh.lru.begin(), sh.lru, it->second);
+        const Entry& e = *it->second;
+        if(!e.states.empty())
+        {
+            path.assign(e.actions.begin(), e.actions.end());
+            hits++;
+            return true;
+        }
+        owner = e.owner;
+        offset = e.offset;
+    }
+
+    // a link: take the tail of its path if the path is still there
+    {
+        Shard& sh = shardOf(owner);
+        lock_guard<mutex> hold(sh.mtx);
+        auto it = sh.index.find(owner);
+        if(it != sh.index.end() && offset < it->second->states.size()
+           && it->second->states[offset] == start)
+        {
+            sh.lru.splice(sh.lru.begin(), sh.lru, it->second);
+            const vector<Action>& acts = it->second->actions;
+            path.assign(acts.begin() + offset, acts.end());
+            hits++;
+            suffixHits++;
+            return true;
+        }
+    }
+    Shard& sh = shardOf(key);
+    lock_guard<mutex> hold(sh.mtx);
+    auto it = sh.index.find(key);
+    if(it != sh.index.end() && it->second->states.empty() && it->second->owner == owner)
+        drop(sh, it->second);
+    misses++;
+    return false;
+}
+
+void ResultCache::insert(Problem* p, State start, const deque<Action>& path)
+{
+    // rough heap cost of an entry: list node, index node and bucket
+    const size_t overhead = sizeof(Entry) + sizeof(Key) + 6 * sizeof(void*);
+    uint64_t rules = p->fingerprint();
+    if(rules == 0)
+        return;
+
+    Entry e;
+    e.key = Key{ rules, start, p->getGoal() };
+    e.states.reserve(path.size() + 1);
+    e.states.push_back(start);
+    for(Action a : path)
+        e.states.push_back(p->result(e.states.back(), a));
+    e.actions.assign(path.begin(), path.end());
+    e.owner = e.key;
+    e.offset = 0;
+    e.bytes = overhead + (e.states.size() + e.actions.size()) * sizeof(State);
+    if(e.bytes > shardLimit)
+        return;
+    inserts++;
+
+    // links for the states inside the path, leaving stored paths alone
+    for(size_t i = 1; i + 1 < e.states.size(); i++)
+    {
+        Entry link;
+        link.key = Key{ rules, e.states[i], e.key.goal };
+        link.owner = e.key;
+        link.offset = i;
+        link.bytes = overhead;
+        Shard& sh = shardOf(link.key);
+        lock_guard<mutex> hold(sh.mtx);
+        auto it = sh.index.find(link.key);
+        if(it == sh.index.end() || it->second->states.empty())
+            put(sh, move(link));
+    }
+    Shard& sh = shardOf(e.key);
+    lock_guard<mutex> hold(sh.mtx);
+    put(sh, move(e));
+}
+
+CacheStats ResultCache::stats()
+{
+    CacheStats st;
+    st.hits = hits;
+    st.suffixHits = suffixHits;
+    st.misses = misses;
+    st.inserts = inserts;
+    st.evictions = evictions;
+    for(Shard& sh : shards)
+    {
+        lock_guard<mutex> hold(sh.mtx);
+        st.entries += sh.lru.size();
+        st.bytes += sh.bytes;
+    }
+    return st;
+}
+
+// BFS() through a result cache: answers from the cache when it can, else
+// searches and stores the result. problems without a fingerprint, or a
+// null cache, always search.
+deque<Action> cachedBFS(Problem* p, ResultCache* cache, SearchStats* stats = nullptr)
+{
+    uint64_t rules = p->fingerprint();
+    deque<Action> path;
+    if(cache && rules && cache->find(rules, p->getInitial(), p->getGoal(), path))
+        return path;
+    path = BFS(p, stats);
+    if(cache && rules)
+        cache->insert(p, p->getInitial(), path);
+    return path;
+}
+
+// prints the counters of a result cache on stderr.
+static void reportCache(ResultCache& cache)
+{
+    CacheStats st = cache.stats();
+    size_t lookups = st.hits + st.misses;
+    fprintf(stderr, "result cache: %zu hits (%zu from suffixes), %zu misses, %.1f%% hit rate\n",
+            st.hits, st.suffixHits, st.misses, lookups ? 100.0 * st.hits / lookups : 0.0);
+    fprintf(stderr, "result cache: %zu paths stored, %zu entries in %zu bytes, %zu evicted\n",
+            st.inserts, st.entries, st.bytes, st.evictions);
+}
+
+// command line settings
+struct Options
+{
+    bool batch = false;              // solve a stream of instances
+    bool binaryIn = false;           // instances are varint encoded
+    const char* input = nullptr;     // instance file, stdin if null
+    const char* output = nullptr;    // result file, stdout if null
+    string format = "codes";         // batch output format, see makeEncoder()
+    unsigned threads = 0;            // solver threads, 0 for one per core
+    size_t batchSize = 4096;         // instances handed to a worker at once
+    string items;                    // crossing items, "wolf,goat*2,cabbage"
+    string eats;                     // crossing conflicts, "wolf:goat,goat:cabbage"
+    string weights;                  // crossing costs by item, "goat:3,wolf:2"
+    int capacity = 1;                // crossing boat capacity
+    bool symmetry = false;           // merge interchangeable crossing items
+    bool stats = false;              // report search counters on stderr
+    bool count = false;              // count the shortest solutions instead
+    bool all = false;                // list every shortest solution instead
+    string engine = "bfs";           // search engine, see solve()
+    bool test = false;               // run the built-in checks
+    size_t benchSets = 0;            // keys for the hash set benchmark, 0 for none
+    size_t benchConcurrent = 0;      // keys for the concurrent set benchmark
+    size_t benchService = 0;         // requests for the solver service benchmark
+    size_t queueSize = 1024;         // requests the solver service queues
+    string listen;                   // daemon address, unix:PATH or tcp:PORT
+    string connect;                  // daemon address of the load generator
+    size_t loadRequests = 0;         // requests the load generator sends
+    size_t cacheBytes = 0;           // result cache size, 0 for none
+    bool successors = false;         // memoize successors in a SuccessorCache
+    size_t successorBytes = 0;       // successor cache size, 0 for no limit
+    bool materialize = false;        // expand every state before searching
+    string exportFile;               // state graph file to write, empty for none
+    ExternalConfig external;         // settings of the external engine
+    HybridConfig hybrid;             // settings of the hybrid engine
+    BitstateConfig bitstate;         // settings of the bitstate engine
+    DeepeningConfig deepening;       // settings of the iddfs and idastar engines
+    SearchLimits limits;             // bounds of the bfs and stepping engines
+    size_t timeout = 0;              // milliseconds bfs or stepping may run, 0 for any
+};
+
+// a batch of instances and the buffer its results are encoded into. jobs
+// are recycled by the pipeline so the buffers keep their capacity.
+struct BatchJob
+{
+    vector<Instance> instances;
+    string out;
+};
+
+// solves every instance of a batch, through the result cache if there is
+// one and expanding states through the successor cache if there is one,
+// and encodes the results into job.out.
+void solveBatch(BatchJob& job, const SolutionEncoder& enc, ResultCache* cache,
+                SuccessorCache* graph)
+{
+    BFSProblem river(0);
+    for(const Instance& in : job.instances)
+    {
+        BFSProblem plain(in.initial, in.goal);
+        CachedProblem cached(&river, graph, in.initial, in.goal);
+        Problem& prob = graph ? (Problem&)cached : plain;
+        deque<Action> soln = cachedBFS(&prob, cache);
+        enc.encode(job.out, in, soln, !soln.empty() || prob.goal_test(in.initial));
+    }
+}
+
+// reads, solves and writes instances as a three stage pipeline: this
+// thread reads batches and queues them on the pool, a writer thread
+// emits the finished batches in input order and hands the jobs back.
+int runBatch(const Options& opt)
+{
+    unique_ptr<SolutionEncoder> enc = makeEncoder(opt.format);
+    if(!enc)
+    {
+        fprintf(stderr, "unknown format: %s\n", opt.format.c_str());
+        return 2;
+    }
+    FILE* in = opt.input ? fopen(opt.input, opt.binaryIn ? "rb" : "r") : stdin;
+    if(!in)
+    {
+        perror(opt.input);
+        return 1;
+    }
+    FILE* out = opt.output ? fopen(opt.output, "wb") : stdout;
+    if(!out)
+    {
+        perror(opt.output);
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    unique_ptr<ResultCache> cache;
+    if(opt.cacheBytes)
+        cache = make_unique<ResultCache>(opt.cacheBytes);
+    ResultCache* shared = cache.get();
+    BFSProblem river(0);
+    unique_ptr<SuccessorCache> graph;
+    if(opt.successors)
+    {
+        graph = make_unique<SuccessorCache>(&river, opt.successorBytes);
+        // all ten safe states are reachable from the start
+        if(opt.materialize)
+            graph->materialize(RPCGW);
+    }
+    SuccessorCache* successors = graph.get();
+    ThreadPool pool(opt.threads);
+    BoundedQueue<future<shared_ptr<BatchJob>>> pending(2 * pool.size() + 2);
+    mutex spareMtx;
+    vector<shared_ptr<BatchJob>> spare;   // written jobs ready for reuse
+    size_t total = 0;
+
+    thread writer([&]()
+    {
+        BufferedWriter w(out);
+        future<shared_ptr<BatchJob>> f;
+        while(pending.pop(f))
+        {
+            shared_ptr<BatchJob> job = f.get();
+            w.write(job->out);
+            lock_guard<mutex> hold(spareMtx);
+            spare.push_back(move(job));
+        }
+    });
+
+    InstanceReader reader(in, opt.binaryIn);
+    const SolutionEncoder& encoder = *enc;
+    for(;;)
+    {
+        shared_ptr<BatchJob> job;
+        {
+            lock_guard<mutex> hold(spareMtx);
+            if(!spare.empty())
+            {
+                job = move(spare.back());
+                spare.pop_back();
+            }
+        }
+        if(!job)
+            job = make_shared<BatchJob>();
+        job->instances.clear();
+        job->out.clear();
+        if(reader.read(job->instances, opt.batchSize) == 0)
+            break;
+        total += job->instances.size();
+        pending.push(pool.submit([job, &encoder, shared, successors]()
+        {
+            solveBatch(*job, encoder, shared, successors);
+            return job;
+        }));
+    }
+    pending.close();
+    writer.join();
+    if(!reader.error().empty())
+    {
+        fprintf(stderr, "%s: %s\n", opt.input ? opt.input : "stdin", reader.error().c_str());
+        if(in != stdin)
+            fclose(in);
+        if(out != stdout)
+            fclose(out);
+        return 1;
+    }
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "solved %zu instances in %.3f s (%.0f instances/s, %u threads)\n",
+            total, secs, secs > 0 ? total / secs : 0.0, pool.size());
+    if(cache)
+        reportCache(*cache);
+    if(graph)
+        reportSuccessors(*graph);
+
+    if(in != stdin)
+        fclose(in);
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
+
+// the outcome of a SolverService request
+struct SolveResult
+{
+    deque<Action> actions;         // the path to the goal, if solved
+    SearchStats stats;             // counters and status of the search
+    double seconds = 0;            // from submit() to the result being set
+};
+
+// counts durations in buckets that grow by a factor of 2^(1/8), from a
+// nanosecond up, so percentiles come out within 9% without keeping the
+// samples. recording is lock free.
+class LatencyHistogram
+{
+    private:
+    static constexpr int STEPS = 8;          // buckets per power of 2
+    array<atomic<uint64_t>, 64 * STEPS> counts;
+    atomic<uint64_t> total;
+    public:
+
+    LatencyHistogram() : total(0)
+    {
+        for(atomic<uint64_t>& c : counts)
+            c = 0;
+    }
+
+    void record(double seconds);
+    // returns the duration below which a fraction q of the samples fall,
+    // rounded up to its bucket's upper edge.
+    double percentile(double q) const;
+    uint64_t count() const { return total; }
+};
+
+void LatencyHistogram::record(double seconds)
+{
+    uint64_t ns = max(1.0, seconds * 1e9);
+    int e = 63 - __builtin_clzll(ns);
+    // the 3 bits below the leading one pick the step within the octave
+    int step = e >= 3 ? (ns >> (e - 3)) & 7 : (ns << (3 - e)) & 7;
+    counts[e * STEPS + step]++;
+    total++;
+}
+
+double LatencyHistogram::percentile(double q) const
+{
+    uint64_t want = max(uint64_t(1), uint64_t(ceil(q * total))), seen = 0;
+    for(size_t i = 0; i < counts.size(); i++)
+    {
+        seen += counts[i];
+        if(seen >= want)
+            return ldexp(double(STEPS + i % STEPS + 1) / STEPS, i / STEPS) * 1e-9;
+    }
+    return 0;
+}
+
+// the per-worker state a SolverService keeps between requests: a
+// SteppingSearch whose visited set and level arrays keep their memory
+// from one search to the next.
+class SolverContext
+{
+    private:
+    SteppingSearch search;
+    public:
+
+    // runs a search to the end or to its limits.
+    void solve(Problem*, const SearchLimits&, SolveResult&);
+};
+
+void SolverContext::solve(Problem* p, const SearchLimits& limits, SolveResult& res)
+{
+    search.reset(p, limits);
+    search.run();
+    res.actions = search.solution();
+    res.stats = search.stats();
+}
+
+// solves problems asynchronously on a fixed set of worker threads, each
+// with its own SolverContext. requests wait in a bounded queue: submit()
+// blocks while it is full, trySubmit() refuses, which pushes back on
+// callers faster than the workers. the queue depth and the latency from
+// submission to result are tracked as metrics.
+class SolverService
+{
+    private:
+    struct Request
+    {
+        shared_ptr<Problem> problem;
+        SearchLimits limits;
+        promise<SolveResult> done;
+        chrono::steady_clock::time_point submitted;
+    };
+
+    BoundedQueue<Request> queue;
+    vector<thread> workers;
+    ResultCache* cache;             // shared results, or null
+    atomic<size_t> peakDepth,       // most requests seen waiting at once
+                   finished;        // requests completed
+    LatencyHistogram latency;
+
+    void work();
+    void noteDepth();
+    public:
+
+    // starts the given number of workers, one per core by default, with
+    // room for queueSize waiting requests. searches that finish are
+    // stored in the cache, if given, and answer later requests.
+    SolverService(unsigned threads = 0, size_t queueSize = 1024, ResultCache* cache = nullptr);
+    // finishes the queued requests, then joins the workers.
+    ~SolverService();
+
+    // queues a search, waiting for room if the queue is full. the
+    // problem must allow concurrent actions() and result() calls if it
+    // is shared between requests.
+    future<SolveResult> submit(shared_ptr<Problem>, const SearchLimits& = SearchLimits());
+    // queues a search if there is room, else returns an invalid future.
+    future<SolveResult> trySubmit(shared_ptr<Problem>, const SearchLimits& = SearchLimits());
+
+    size_t queueDepth() { return queue.size(); }
+    size_t peakQueueDepth() const { return peakDepth; }
+    size_t completed() const { return finished; }
+    const LatencyHistogram& latencies() const { return latency; }
+    unsigned size() const { return workers.size(); }
+};
+
+SolverService::SolverService(unsigned threads, size_t queueSize, ResultCache* cache)
+    : queue(max(size_t(1), queueSize)), cache(cache), peakDepth(0), finished(0)
+{
+    if(threads == 0)
+        threads = max(1u, thread::hardware_concurrency());
+    for(unsigned i = 0; i < threads; i++)
+        workers.emplace_back(&SolverService::work, this);
+}
+
+SolverService::~SolverService()
+{
+    queue.close();
+    for(thread& t : workers)
+        t.join();
+}
+
+void SolverService::noteDepth()
+{
+    size_t depth = queue.size(), peak = peakDepth;
+    while(depth > peak && !peakDepth.compare_exchange_weak(peak, depth))
+        ;
+}
+
+future<SolveResult> SolverService::submit(shared_ptr<Problem> p, const SearchLimits& limits)
+{
+    Request r{ move(p), limits, promise<SolveResult>(), chrono::steady_clock::now() };
+    future<SolveResult> f = r.done.get_future();
+    queue.push(move(r));
+    noteDepth();
+    return f;
+}
+
+future<SolveResult> SolverService::trySubmit(shared_ptr<Problem> p, const SearchLimits& limits)
+{
+    Request r{ move(p), limits, promise<SolveResult>(), chrono::steady_clock::now() };
+    future<SolveResult> f = r.done.get_future();
+    if(!queue.tryPush(r))
+        return future<SolveResult>();
+    noteDepth();
+    return f;
+}
+
+void SolverService::work()
+{
+    SolverContext ctx;
+    Request r;
+    while(queue.pop(r))
+    {
+        SolveResult res;
+        Problem* p = r.problem.get();
+        if(cache && p->fingerprint()
+           && cache->find(p->fingerprint(), p->getInitial(), p->getGoal(), res.actions))
+            res.stats.status = res.actions.empty() && !p->goal_test(p->getInitial())
+                             ? Unsolvable : Solved;
+        else
+        {
+            ctx.solve(p, r.limits, res);
+            if(cache && (res.stats.status == Solved || res.stats.status == Unsolvable))
+                cache->insert(p, p->getInitial(), res.actions);
+        }
+        res.seconds = chrono::duration<double>(chrono::steady_clock::now() - r.submitted).count();
+        latency.record(res.seconds);
+        finished++;
+        r.done.set_value(move(res));
+        r.problem.reset();
+    }
+}
+
+// set by ^C while a stepping search or the daemon runs
+static atomic<bool> interrupted(false);
+
+static void onInterrupt(int)
+{
+    interrupted = true;
+}
+
+#ifdef __linux__
+// solver daemon wire format. every frame is a LEB128 varint payload
+// length followed by the payload, itself varints:
+//   request:  id, kind, initial, goal
+//   response: id, status, action count, actions...
+// kind 0 is the peasant, wolf, goat and cabbage rules, the only problem
+// family served so far. status is 0 solved, 1 unsolvable, 2 bad request.
+// responses on one connection may come back out of request order.
+
+// reads a varint from [p, end), advancing p. returns false if the bytes
+// run out first, or on a varint longer than 64 bits.
+static bool takeVarint(const char*& p, const char* end, unsigned long long& v)
+{
+    v = 0;
+    for(int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        unsigned char c = *p++;
+        // the tenth byte holds the 64th bit alone
+        if(shift == 63 && c > 1)
+            return false;
+        v |= (unsigned long long)(c & 0x7F) << shift;
+        if(!(c & 0x80))
+            return true;
+    }
+    return false;
+}
+
+// appends a frame holding the payload.
+static void appendFrame(string& out, const string& payload)
+{
+    appendVarint(out, payload.size());
+    out += payload;
+}
+
+// takes the payload of the next whole frame from buf at offset at, or
+// returns false if no whole frame has arrived yet. sets bad, and returns
+// false, on a length that is no varint or is over limit bytes: such a
+// frame will never complete.
+static bool takeFrame(const string& buf, size_t& at, string& payload, size_t limit, bool& bad)
+{
+    const char* p = buf.data() + at;
+    const char* end = buf.data() + buf.size();
+    unsigned long long n;
+    if(!takeVarint(p, end, n))
+    {
+        // ten bytes always hold a whole varint
+        bad = size_t(end - (buf.data() + at)) >= 10;
+        return false;
+    }
+    if(n > limit)
+    {
+        bad = true;
+        return false;
+    }
+    if(size_t(end - p) < n)
+        return false;
+    payload.assign(p, n);
+    at = p + n - buf.data();
+    return true;
+}
+
+// opens a socket for "unix:PATH" or "tcp:PORT" (on 127.0.0.1), listening
+// on it or connected to it. returns -1 after reporting a failure.
+static int openSocket(const string& addr, bool listening)
+{
+    sockaddr_storage sa;
+    socklen_t len;
+    memset(&sa, 0, sizeof(sa));
+    if(addr.compare(0, 5, "unix:") == 0 && addr.size() - 5 < sizeof(sockaddr_un::sun_path))
+    {
+        sockaddr_un* un = (sockaddr_un*)&sa;
+        un->sun_family = AF_UNIX;
+        strcpy(un->sun_path, addr.c_str() + 5);
+        len = sizeof(sockaddr_un);
+        if(listening)
+            unlink(un->sun_path);
+    }
+    else if(addr.compare(0, 4, "tcp:") == 0)
+    {
+        sockaddr_in* in = (sockaddr_in*)&sa;
+        in->sin_family = AF_INET;
+        in->sin_port = htons(atoi(addr.c_str() + 4));
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        len = sizeof(sockaddr_in);
+    }
+    else
+    {
+        fprintf(stderr, "bad address %s, expected unix:PATH or tcp:PORT\n", addr.c_str());
+        return -1;
+    }
+
+    int fd = socket(sa.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int on = 1;
+    if(fd >= 0 && sa.ss_family == AF_INET)
+    {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if(!listening)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    if(fd < 0 || (listening ? bind(fd, (sockaddr*)&sa, len) < 0 || listen(fd, 128) < 0
+                            : connect(fd, (sockaddr*)&sa, len) < 0))
+    {
+        perror(addr.c_str());
+        if(fd >= 0)
+            close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// one request read by the daemon and not yet answered
+struct DaemonRequest
+{
+    uint64_t conn;                 // connection it came on
+    unsigned long long id, kind;
+    State initial, goal;
+};
+
+// a client connection of the daemon. connections are known by a serial
+// number, never reused, so answers cannot reach a later connection that
+// was given the same descriptor.
+struct DaemonConnection
+{
+    int fd;
+    string in,                     // bytes read, not yet parsed
+           out;                    // bytes to send
+    size_t sent = 0;               // bytes of out already sent
+    bool reading = true;           // the peer has not shut down its side
+    uint32_t events = EPOLLIN;     // events epoll watches for
+};
+
+// bytes a connection may have waiting in either direction. a longer
+// request ends the connection; past this much output, reading stops
+// until the peer catches up.
+static const size_t DAEMON_BUFFER = 1 << 20;
+
+// serves solve requests on a socket until ^C. one thread runs an epoll
+// loop over the listener and all connections with non-blocking sockets.
+// after each wakeup, the requests read are grouped by problem and goal,
+// every group is solved by one multiSourceBFS() on the pool, and the
+// answers are queued on their connections. a peer that shuts down its
+// side is still sent its answers before the connection is closed.
+int runDaemon(const Options& opt)
+{
+    int listener = openSocket(opt.listen, true);
+    if(listener < 0)
+        return 1;
+    fcntl(listener, F_SETFL, O_NONBLOCK);
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    epoll_ctl(ep, EPOLL_CTL_ADD, listener, &ev);
+
+    signal(SIGPIPE, SIG_IGN);
+    interrupted = false;
+    signal(SIGINT, onInterrupt);
+
+    ThreadPool pool(opt.threads);
+    unordered_map<uint64_t, DaemonConnection> conns;   // by serial number, from 1
+    uint64_t serial = 0;
+    vector<epoll_event> events(256);
+    vector<DaemonRequest> batch;
+    size_t served = 0, searches = 0;
+    char chunk[1 << 16];
+
+    // sets the events epoll watches on a connection from its state
+    auto watch = [&](uint64_t id, DaemonConnection& c)
+    {
+        uint32_t want = (c.reading && c.out.size() < DAEMON_BUFFER ? uint32_t(EPOLLIN) : 0)
+                      | (c.sent < c.out.size() ? uint32_t(EPOLLOUT) : 0);
+        if(want == c.events)
+            return;
+        epoll_event e = {};
+        e.events = want;
+        e.data.u64 = id;
+        epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &e);
+        c.events = want;
+    };
+    // sends what it can of a connection's output. returns false if the
+    // connection failed.
+    auto flush = [&](uint64_t id, DaemonConnection& c)
+    {
+        while(c.sent < c.out.size())
+        {
+            ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+            if(n < 0 && errno == EAGAIN)
+                break;
+            if(n <= 0)
+                return false;
+            c.sent += n;
+        }
+        if(c.sent == c.out.size())
+        {
+            c.out.clear();
+            c.sent = 0;
+        }
+        watch(id, c);
+        return true;
+    };
+    auto drop = [&](uint64_t id)
+    {
+        auto it = conns.find(id);
+        epoll_ctl(ep, EPOLL_CTL_DEL, it->second.fd, nullptr);
+        close(it->second.fd);
+        conns.erase(it);
+    };
+    // queues the response to a request, path null for a bad request.
+    // returns false if the connection is gone.
+    auto answer = [&](const DaemonRequest& r, const deque<Action>* path)
+    {
+        auto it = conns.find(r.conn);
+        if(it == conns.end())
+            return false;
+        unsigned status = path ? path->empty() && r.initial != r.goal : 2;
+        string payload;
+        appendVarint(payload, r.id);
+        appendVarint(payload, status);
+        appendVarint(payload, path ? path->size() : 0);
+        if(path)
+            for(Action a : *path)
+                appendVarint(payload, a);
+        appendFrame(it->second.out, payload);
+        return true;
+    };
+    unique_ptr<ResultCache> cache;
+    if(opt.cacheBytes)
+        cache = make_unique<ResultCache>(opt.cacheBytes);
+    BFSProblem river(0);
+    deque<Action> hit;
+
+    fprintf(stderr, "listening on %s\n", opt.listen.c_str());
+    while(!interrupted)
+    {
+        int n = epoll_wait(ep, events.data(), events.size(), 200);
+        batch.clear();
+        for(int i = 0; i < n; i++)
+        {
+            uint64_t id = events[i].data.u64;
+            if(id == 0)
+            {
+                int fd;
+                while((fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    epoll_event e = {};
+                    e.events = EPOLLIN;
+                    e.data.u64 = ++serial;
+                    epoll_ctl(ep, EPOLL_CTL_ADD, fd, &e);
+                    conns[serial].fd = fd;
+                }
+                continue;
+            }
+            auto it = conns.find(id);
+            if(it == conns.end())
+                continue;
+            DaemonConnection& c = it->second;
+            if((events[i].events & (EPOLLOUT | EPOLLERR)) && !flush(id, c))
+            {
+                drop(id);
+                continue;
+            }
+            if(!(c.events & EPOLLIN) || !(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+                continue;
+
+            // read up to the buffer limit; 0 bytes means the peer is done
+            // sending but still waits for its answers
+            bool failed = false;
+            while(c.in.size() < DAEMON_BUFFER)
+            {
+                ssize_t got = recv(c.fd, chunk, min(sizeof(chunk), DAEMON_BUFFER - c.in.size()), 0);
+                if(got > 0)
+                    c.in.append(chunk, got);
+                else
+                {
+                    c.reading = got < 0 && errno == EAGAIN;
+                    failed = got < 0 && errno != EAGAIN;
+                    break;
+                }
+            }
+            size_t at = 0;
+            string payload;
+            bool bad = false;
+            while(takeFrame(c.in, at, payload, DAEMON_BUFFER, bad))
+            {
+                DaemonRequest r{ id, 0, 0, 0, 0 };
+                const char* p = payload.data();
+                const char* end = p + payload.size();
+                if(!takeVarint(p, end, r.id) || !takeVarint(p, end, r.kind)
+                    || !takeVarint(p, end, r.initial) || !takeVarint(p, end, r.goal))
+                    r.kind = ULLONG_MAX;
+                if(cache && r.kind == 0
+                   && cache->find(river.fingerprint(), r.initial, r.goal, hit))
+                    served += answer(r, &hit);
+                else
+                    batch.push_back(r);
+            }
+            c.in.erase(0, at);
+            // a frame that cannot fit in the buffer will never complete
+            if(failed || bad || c.in.size() >= DAEMON_BUFFER)
+                drop(id);
+            else
+                watch(id, c);
+        }
+
+        // one search per (kind, goal) group, each answering every
+        // request of the group
+        sort(batch.begin(), batch.end(), [](const DaemonRequest& a, const DaemonRequest& b)
+             { return a.kind != b.kind ? a.kind < b.kind : a.goal < b.goal; });
+        vector<future<vector<deque<Action>>>> groups;
+        vector<size_t> starts;
+        for(size_t i = 0, j; i < batch.size(); i = j)
+        {
+            for(j = i + 1; j < batch.size() && batch[j].kind == batch[i].kind
+                                             && batch[j].goal == batch[i].goal; j++)
+                ;
+            starts.push_back(i);
+            if(batch[i].kind != 0)
+                continue;
+            groups.push_back(pool.submit([&batch, i, j]()
+            {
+                vector<State> sources;
+                for(size_t k = i; k < j; k++)
+                    sources.push_back(batch[k].initial);
+                BFSProblem prob(sources[0], batch[i].goal);
+                return multiSourceBFS(&prob, sources);
+            }));
+        }
+        starts.push_back(batch.size());
+        searches += groups.size();
+
+        size_t g = 0;
+        for(size_t s = 0; s + 1 < starts.size(); s++)
+        {
+            vector<deque<Action>> paths;
+            if(batch[starts[s]].kind == 0)
+                paths = groups[g++].get();
+            for(size_t k = starts[s]; k < starts[s + 1]; k++)
+            {
+                const DaemonRequest& r = batch[k];
+                if(r.kind != 0)
+                {
+                    served += answer(r, nullptr);
+                    continue;
+                }
+                const deque<Action>& path = paths[k - starts[s]];
+                served += answer(r, &path);
+                if(cache)
+                {
+                    BFSProblem prob(r.initial, r.goal);
+                    cache->insert(&prob, r.initial, path);
+                }
+            }
+        }
+        // send the new answers; close connections the peer has shut down
+        // once everything owed to them is sent
+        for(auto it = conns.begin(); it != conns.end(); )
+        {
+            uint64_t id = it->first;
+            DaemonConnection& c = (it++)->second;
+            if(!flush(id, c) || (!c.reading && c.out.empty()))
+                drop(id);
+        }
+    }
+
+    signal(SIGINT, SIG_DFL);
+    for(auto& c : conns)
+        close(c.second.fd);
+    close(ep);
+    close(listener);
+    if(opt.listen.compare(0, 5, "unix:") == 0)
+        unlink(opt.listen.c_str() + 5);
+    fprintf(stderr, "served %zu requests with %zu searches\n", served, searches);
+    if(cache)
+        reportCache(*cache);
+    return 0;
+}
+
+// load generator for the daemon: -j connections each send random river
+// crossing pairs in bursts of up to 64 outstanding requests until N are
+// answered in all, checking every returned path, then reports the
+// throughput and latency percentiles.
+int runLoadClient(const Options& opt)
+{
+    static const State river[] = { RPCGW, PCGWR, PGRCW, CWRPG, PCGRW,
+                                   WRPCG, CRPGW, PGWRC, GRPCW, PCWRG };
+    const size_t window = 64;
+    unsigned conns = opt.threads ? opt.threads : 4;
+    LatencyHistogram latency;
+    atomic<size_t> done(0), wrong(0);
+    atomic<bool> failed(false);
+    vector<thread> clients;
+    auto start = chrono::steady_clock::now();
+
+    for(unsigned t = 0; t < conns; t++)
+        clients.emplace_back([&, t]()
+        {
+            int fd = openSocket(opt.connect, false);
+            if(fd < 0)
+            {
+                failed = true;
+                return;
+            }
+            mt19937_64 rng(t + 1);
+            size_t quota = opt.loadRequests / conns + (t < opt.loadRequests % conns);
+            vector<Instance> sent;
+            string in, out, payload;
+            char chunk[1 << 16];
+            for(size_t base = 0; base < quota && !failed; base += sent.size())
+            {
+                // send a burst, then read its answers
+                sent.clear();
+                out.clear();
+                for(size_t k = 0; k < window && base + k < quota; k++)
+                {
+                    Instance inst = { river[rng() % 10], river[rng() % 10] };
+                    sent.push_back(inst);
+                    payload.clear();
+                    appendVarint(payload, k);
+                    appendVarint(payload, 0);
+                    appendVarint(payload, inst.initial);
+                    appendVarint(payload, inst.goal);
+                    appendFrame(out, payload);
+                }
+                auto burst = chrono::steady_clock::now();
+                for(size_t off = 0; off < out.size(); )
+                {
+                    ssize_t n = send(fd, out.data() + off, out.size() - off, MSG_NOSIGNAL);
+                    if(n <= 0)
+                    {
+                        failed = true;
+                        break;
+                    }
+                    off += n;
+                }
+                size_t answered = 0, at = 0;
+                while(answered < sent.size() && !failed)
+                {
+                    bool bad = false;
+                    if(!takeFrame(in, at, payload, DAEMON_BUFFER, bad))
+                    {
+                        if(bad)
+                        {
+                            failed = true;
+                            break;
+                        }
+                        in.erase(0, at);
+                        at = 0;
+                        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+                        if(n <= 0)
+                            failed = true;
+                        else
+                            in.append(chunk, n);
+                        continue;
+                    }
+                    latency.record(chrono::duration<double>(chrono::steady_clock::now() - burst).count());
+                    const char* p = payload.data();
+                    const char* end = p + payload.size();
+                    unsigned long long id, status, count, a;
+                    bool ok = takeVarint(p, end, id) && takeVarint(p, end, status)
+                           && takeVarint(p, end, count) && id < sent.size() && status == 0;
+                    State s = ok ? sent[id].initial : 0;
+                    BFSProblem prob(s, ok ? sent[id].goal : 0);
+                    for(unsigned long long k = 0; ok && k < count; k++)
+                    {
+                        deque<Action> acts = prob.actions(s);
+                        ok = takeVarint(p, end, a) && find(acts.begin(), acts.end(), a) != acts.end();
+                        s = prob.result(s, a);
+                    }
+                    wrong += !ok || !prob.goal_test(s);
+                    answered++;
+                }
+                in.erase(0, at);
+                done += answered;
+            }
+            close(fd);
+        });
+    for(thread& c : clients)
+        c.join();
+    if(failed)
+    {
+        fprintf(stderr, "lost the connection to %s\n", opt.connect.c_str());
+        return 1;
+    }
+
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("%zu requests on %u connections in %.3f s (%.0f requests/s), %zu wrong\n",
+           size_t(done), conns, secs, done / secs, size_t(wrong));
+    printf("latency p50 %.3g s, p90 %.3g s, p99 %.3g s, max %.3g s\n",
+           latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99),
+           latency.percentile(1));
+    return wrong ? 1 : 0;
+}
+#endif
+
+static vector<string> split(const string& text, char sep)
+{
+    vector<string> parts;
+    size_t start = 0;
+    while(start <= text.size())
+    {
+        size_t end = text.find(sep, start);
+        if(end == string::npos)
+            end = text.size();
+        if(end > start)
+            parts.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+    return parts;
+}
+
+// builds the crossing problem described by --items, --eats and --weights, or
+// returns nullptr and reports the problem on stderr.
+unique_ptr<CrossingProblem> makeCrossing(const Options& opt)
+{
+    vector<string> names;
+    for(const string& item : split(opt.items, ','))
+    {
+        size_t star = item.find('*');
+        int count = star == string::npos ? 1 : atoi(item.c_str() + star + 1);
+        for(int i = 0; i < count; i++)
+            names.push_back(item.substr(0, star));
+    }
+    if(names.empty() || names.size() > 63)
+    {
+        fprintf(stderr, "--items needs between 1 and 63 items\n");
+        return nullptr;
+    }
+
+    vector<pair<string, string>> eaten;
+    for(const string& rule : split(opt.eats, ','))
+    {
+        size_t colon = rule.find(':');
+        if(colon == string::npos
+            || find(names.begin(), names.end(), rule.substr(0, colon)) == names.end()
+            || find(names.begin(), names.end(), rule.substr(colon + 1)) == names.end())
+        {
+            fprintf(stderr, "bad --eats rule: %s\n", rule.c_str());
+            return nullptr;
+        }
+        eaten.push_back({ rule.substr(0, colon), rule.substr(colon + 1) });
+    }
+
+    unique_ptr<CrossingProblem> prob =
+        make_unique<CrossingProblem>(names, eaten, max(1, opt.capacity), opt.symmetry);
+    for(const string& rule : split(opt.weights, ','))
+    {
+        size_t colon = rule.find(':');
+        long w = colon == string::npos ? 0 : atol(rule.c_str() + colon + 1);
+        if(w < 1 || find(names.begin(), names.end(), rule.substr(0, colon)) == names.end())
+        {
+            fprintf(stderr, "bad --weights rule: %s\n", rule.c_str());
+            return nullptr;
+        }
+        prob->setWeight(rule.substr(0, colon), w);
+    }
+    return prob;
+}
+
+static void reportStats(const SearchStats& st)
+{
+    fprintf(stderr, "expanded %zu, generated %zu, stored %zu states\n",
+            st.expanded, st.generated, st.stored);
+    if(st.ranked)
+        fprintf(stderr, "ranked %zu states\n", st.ranked);
+    if(st.bytes)
+        fprintf(stderr, "search tables peaked at %zu bytes\n", st.bytes);
+    if(st.diskBytes)
+        fprintf(stderr, "wrote %zu bytes to disk\n", st.diskBytes);
+    if(st.spills || st.reloads)
+        fprintf(stderr, "spilled %zu levels, reloaded %zu\n", st.spills, st.reloads);
+    if(st.failedSpills)
+        fprintf(stderr, "could not spill %zu levels, kept them in memory\n", st.failedSpills);
+    if(st.omitted > 0)
+        fprintf(stderr, "expected %.3g states omitted, %.3g chance of omitting any\n",
+                st.omitted, 1 - exp(-st.omitted));
+    if(st.status == OverBudget)
+        fprintf(stderr, "stopped at a search limit\n");
+    else if(st.status == Cancelled)
+        fprintf(stderr, "cancelled\n");
+    else if(st.status == Failed)
+        fprintf(stderr, "failed\n");
+}
+
+// the line printed when a search stopped before an answer, or ""
+static string stopText(SearchStatus status)
+{
+    if(status == OverBudget)
+        return "No solution within the search limits.\n";
+    if(status == Cancelled)
+        return "Search cancelled.\n";
+    if(status == Failed)
+        return "Search failed.\n";
+    return "";
+}
+
+// counts the shortest solutions of a problem, e.g. "2 shortest solutions
+// of 7 crossings."
+static string countText(Problem* p, SearchStats* st)
+{
+    size_t length;
+    PathCount n = countShortestPaths(p, length, st);
+    string text = n.str();
+    if(text == "0")
+        return "No solution.\n";
+    return text + (text == "1" ? " shortest solution of " : " shortest solutions of ")
+        + to_string(length) + (length == 1 ? " crossing.\n" : " crossings.\n");
+}
+
+// true if any of --max-nodes, --max-depth or --timeout was given.
+static bool limited(const Options& opt)
+{
+    return opt.timeout || opt.limits.maxExpanded != SIZE_MAX
+        || opt.limits.maxDepth != SIZE_MAX;
+}
+
+// the engine names solve() knows
+static const char* const ENGINES[] = {
+    "bfs", "ranked", "packed", "twobit", "external", "hybrid", "parallel", "bitstate",
+    "astar", "dijkstra", "iddfs", "idastar", "parallel-idastar", "stepping"
+};
+
+// true if solve() knows the engine name.
+static bool knownEngine(const string& name)
+{
+    return find(begin(ENGINES), end(ENGINES), name) != end(ENGINES);
+}
+
+// runs the search engine selected by opt.engine:
+//   bfs     node based breadth first search, BFS()
+//   ranked  breadth first search over dense state ranks, rankedBFS()
+//   packed  ranked search keeping one packed undo action per state, packedBFS()
+//   twobit  ranked search keeping 2 bits per state, twoBitBFS()
+//   external  disk based search with delayed duplicate detection, externalBFS()
+//   hybrid  in-memory level search that spills cold levels to disk, hybridBFS()
+//   parallel  multithreaded level search on a shared visited set, parallelBFS()
+//   bitstate  level search keeping old levels as Bloom filters, bitstateBFS()
+//   astar   best first search guided by Problem::heuristic(), aStar()
+//   dijkstra  cheapest first search by Problem::cost(), aStar()
+//   stepping  BFS() run one level at a time, SteppingSearch
+//   iddfs   iterative deepening depth first search, deepeningSearch()
+//   idastar iterative deepening A*, deepeningSearch()
+//   parallel-idastar  iterative deepening A* on -j threads, parallelDeepening()
+deque<Action> solve(Problem* p, const Options& opt, SearchStats* st)
+{
+    // an engine that cannot take the problem fails the search
+    auto refuse = [st](const string& why)
+    {
+        fprintf(stderr, "%s\n", why.c_str());
+        if(st)
+            st->status = Failed;
+        return deque<Action>();
+    };
+    if(opt.engine == "bfs" || opt.engine == "stepping")
+    {
+        // ^C cancels the search, which still reports what it did
+        SearchLimits limits = opt.limits;
+        interrupted = false;
+        limits.cancel = &interrupted;
+        if(opt.timeout)
+            limits.deadline = chrono::steady_clock::now() + chrono::milliseconds(opt.timeout);
+        signal(SIGINT, onInterrupt);
+        if(opt.engine == "bfs")
+        {
+            deque<Action> path = BFS(p, st, limits);
+            signal(SIGINT, SIG_DFL);
+            return path;
+        }
+
+        SteppingSearch search(p, limits);
+        while(search.stepLevel() == Running)
+            if(opt.stats)
+                fprintf(stderr, "depth %zu: %zu states queued, %zu expanded\n",
+                        search.depth(), search.frontier(), search.stats().expanded);
+        signal(SIGINT, SIG_DFL);
+        if(st)
+            *st = search.stats();
+        return search.solution();
+    }
+    if(opt.engine == "iddfs" || opt.engine == "idastar" || opt.engine == "parallel-idastar")
+    {
+        DeepeningConfig cfg = opt.deepening;
+        cfg.heuristic = opt.engine != "iddfs";
+        if(opt.engine == "parallel-idastar")
+            return parallelDeepening(p, cfg, opt.threads, st);
+        return deepeningSearch(p, cfg, st);
+    }
+    if(opt.engine == "astar" || opt.engine == "dijkstra")
+        return aStar(p, opt.engine == "astar", st);
+    if(opt.engine == "bitstate")
+    {
+        if(!p->reversible())
+        {
+            return refuse("the bitstate engine needs a reversible problem");
+        }
+        return bitstateBFS(p, opt.bitstate, st);
+    }
+    if(opt.engine == "parallel")
+        return parallelBFS(p, opt.threads, st);
+    if(opt.engine == "hybrid")
+        return hybridBFS(p, opt.hybrid, st);
+    if(opt.engine == "external")
+    {
+        if(!p->reversible())
+        {
+            return refuse("the external engine needs a reversible problem");
+        }
+        return externalBFS(p, opt.external, st);
+    }
+    if(opt.engine == "packed" || opt.engine == "twobit")
+    {
+        if(!p->reversible() || !p->maxActions())
+        {
+            return refuse("the " + opt.engine + " engine needs a reversible problem");
+        }
+        unique_ptr<StateRanking> r = p->ranking();
+        if(st)
+            st->ranked = r->size();
+        // the packed frontier holds 32-bit ranks; the two-bit table takes
+        // a quarter byte per rank, which must not overflow a size_t. a
+        // ranking too large to count saturates at SIZE_MAX.
+        if(r->size() >= (opt.engine == "twobit" ? SIZE_MAX / 4 : UINT32_MAX))
+        {
+            return refuse(to_string(r->size()) + " ranked states are too many for the "
+                          + opt.engine + " engine");
+        }
+        if(opt.engine == "twobit")
+            return twoBitBFS(p, *r, opt.threads, st);
+        return packedBFS(p, *r, st);
+    }
+    if(opt.engine == "ranked")
+    {
+        unique_ptr<StateRanking> r = p->ranking();
+        if(st)
+            st->ranked = r->size();
+        if(r->size() >= UINT32_MAX)
+        {
+            return refuse(to_string(r->size())
+                          + " ranked states are too many for the ranked engine");
+        }
+        return rankedBFS(p, *r, st);
+    }
+    return BFS(p, st);
+}
+
+// returns one sentence per crossing of a solution.
+static string describeCrossings(CrossingProblem* p, const deque<Action>& soln)
+{
+    string text;
+    State state = p->getInitial();
+    for(Action a : soln)
+    {
+        text += p->describe(state, a);
+        text += '\n';
+        state = p->result(state, a);
+    }
+    return text;
+}
+
+// solves a generalized crossing instance from all items on the left
+// bank to all on the right, printing one sentence per crossing.
+int runCrossing(const Options& opt)
+{
+    unique_ptr<CrossingProblem> prob = makeCrossing(opt);
+    if(!prob)
+        return 2;
+
+    // the engines search through the successor cache if asked to
+    unique_ptr<SuccessorCache> graph;
+    unique_ptr<CachedProblem> cached;
+    Problem* search = prob.get();
+    if(opt.successors)
+    {
+        graph = make_unique<SuccessorCache>(prob.get(), opt.successorBytes);
+        if(opt.materialize && !graph->materialize(prob->getInitial()))
+            fprintf(stderr, "the state graph does not fit in the successor cache\n");
+        cached = make_unique<CachedProblem>(prob.get(), graph.get(), prob->getInitial(),
+                                            prob->getGoal());
+        search = cached.get();
+    }
+
+    SearchStats st;
+    string text;
+    if(opt.all)
+    {
+        BufferedWriter out(stdout);
+        size_t n = 0;
+        for(const deque<Action>& soln : shortestSolutions(search))
+            out.write("Solution " + to_string(++n) + ":\n" + describeCrossings(prob.get(), soln));
+        if(n == 0)
+            out.write("No solution.\n");
+        return 0;
+    }
+    if(opt.count)
+        text = countText(search, &st);
+    else
+    {
+        deque<Action> soln = solve(search, opt, &st);
+        text = describeCrossings(prob.get(), soln);
+        string stop = stopText(st.status);
+        if(!stop.empty())
+            text += stop;
+        else if(soln.empty() && !prob->goal_test(prob->getInitial()))
+            text += "No solution.\n";
+        else if(!opt.weights.empty())
+            text += "Total cost " + to_string(pathCost(prob.get(), soln)) + ".\n";
+    }
+    BufferedWriter(stdout).write(text);
+
+    if(opt.stats)
+    {
+        reportStats(st);
+        if(prob->hasSymmetry())
+            fprintf(stderr, "symmetry group order %.0f\n", prob->symmetryOrder());
+        if(graph)
+            reportSuccessors(*graph);
+    }
+    return 0;
+}
+
+// times insert-if-absent of n keys, half of them repeats, into
+// FlatHashSet and std::unordered_set.
+int runSetBenchmark(size_t n)
+{
+    vector<State> keys(n);
+    mt19937_64 rng(42);
+    for(State& k : keys)
+        k = rng() % max(size_t(1), n / 2) * 0x9E3779B97F4A7C15ull;
+
+    auto time = [&keys](auto& set, const char* name)
+    {
+        auto start = chrono::steady_clock::now();
+        size_t added = 0;
+        for(State k : keys)
+            added += set.insert(k).second;
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        printf("%-20s %10zu distinct  %8.1f M inserts/s\n", name, added,
+               keys.size() / secs / 1e6);
+    };
+
+    struct FlatAdapter
+    {
+        FlatHashSet<State> set;
+        pair<int, bool> insert(State k) { return { 0, set.insert(k) }; }
+    } flat;
+    unordered_set<State, StateHash> node;
+    time(flat, "FlatHashSet");
+    time(node, "std::unordered_set");
+    printf("FlatHashSet holds %zu bytes\n", flat.set.bytes());
+    return 0;
+}
+
+// times concurrent insert-if-absent of n keys into ConcurrentStateSet
+// for 1 to maxThreads threads and several shares of repeated keys.
+int runConcurrentBenchmark(size_t n, unsigned maxThreads)
+{
+    mt19937_64 rng(42);
+    vector<State> keys(n);
+    printf("%8s %8s %10s %14s\n", "threads", "repeats", "distinct", "M inserts/s");
+    for(double repeats : { 0.0, 0.5, 0.9 })
+    {
+        size_t range = max(size_t(1), size_t(n * (1 - repeats)));
+        for(size_t i = 0; i < n; i++)
+            keys[i] = (repeats == 0 ? i : rng() % range) * 0x9E3779B97F4A7C15ull + 1;
+
+        for(unsigned t = 1; t <= maxThreads; t *= 2)
+        {
+            ConcurrentStateSet set;
+            vector<thread> workers;
+            auto start = chrono::steady_clock::now();
+            for(unsigned w = 0; w < t; w++)
+                workers.emplace_back([&keys, &set, w, t]()
+                {
+                    for(size_t i = w; i < keys.size(); i += t)
+                        set.insert(keys[i]);
+                });
+            for(thread& w : workers)
+                w.join();
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            printf("%8u %7.0f%% %10zu %14.1f\n", t, repeats * 100, set.size(), n / secs / 1e6);
+        }
+    }
+    return 0;
+}
+
+// submits n searches to a SolverService, either of the --items instance
+// or of random river crossing pairs, and reports throughput, queue depth
+// and latency percentiles.
+int runServiceBenchmark(const Options& opt)
+{
+    static const State river[] = { RPCGW, PCGWR, PGRCW, CWRPG, PCGRW,
+                                   WRPCG, CRPGW, PGWRC, GRPCW, PCWRG };
+    shared_ptr<Problem> crossing;
+    if(!opt.items.empty() && !(crossing = makeCrossing(opt)))
+        return 2;
+    // the river requests share one set of rules, and through them one
+    // successor cache
+    shared_ptr<Problem> rules = crossing ? crossing : make_shared<BFSProblem>(0);
+    unique_ptr<SuccessorCache> graph;
+    if(opt.successors)
+    {
+        graph = make_unique<SuccessorCache>(rules.get(), opt.successorBytes);
+        if(opt.materialize)
+            graph->materialize(crossing ? rules->getInitial() : RPCGW);
+        if(crossing)
+            crossing = make_shared<CachedProblem>(rules.get(), graph.get(),
+                                                  rules->getInitial(), rules->getGoal());
+    }
+    auto request = [&](State initial, State goal) -> shared_ptr<Problem>
+    {
+        if(graph)
+            return make_shared<CachedProblem>(rules.get(), graph.get(), initial, goal);
+        return make_shared<BFSProblem>(initial, goal);
+    };
+
+    mt19937_64 rng(42);
+    vector<future<SolveResult>> results;
+    results.reserve(opt.benchService);
+    size_t solved = 0;
+    unique_ptr<ResultCache> cache;
+    if(opt.cacheBytes)
+        cache = make_unique<ResultCache>(opt.cacheBytes);
+    auto start = chrono::steady_clock::now();
+    {
+        SolverService service(opt.threads, opt.queueSize, cache.get());
+        for(size_t i = 0; i < opt.benchService; i++)
+        {
+            State initial = river[rng() % 10];
+            results.push_back(service.submit(crossing ? crossing
+                                             : request(initial, river[rng() % 10])));
+        }
+        for(future<SolveResult>& f : results)
+            solved += f.get().stats.status == Solved;
+
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        const LatencyHistogram& lat = service.latencies();
+        printf("%zu requests, %zu solved, in %.3f s (%.0f requests/s, %u workers)\n",
+               service.completed(), solved, secs, service.completed() / secs, service.size());
+        printf("peak queue depth %zu of %zu\n", service.peakQueueDepth(), opt.queueSize);
+        printf("latency p50 %.3g s, p90 %.3g s, p99 %.3g s, max %.3g s\n",
+               lat.percentile(0.5), lat.percentile(0.9), lat.percentile(0.99), lat.percentile(1));
+    }
+    if(cache)
+        reportCache(*cache);
+    if(graph)
+        reportSuccessors(*graph);
+    return 0;
+}
+
+// writes the state graph of the river puzzle, or of the --items crossing,
+// with exportGraph().
+int runExport(const Options& opt)
+{
+    unique_ptr<Problem> prob;
+    if(opt.items.empty())
+        prob = make_unique<BFSProblem>(RPCGW, PCGWR);
+    else if(!(prob = makeCrossing(opt)))
+        return 2;
+
+    size_t states, edges;
+    auto start = chrono::steady_clock::now();
+    if(!exportGraph(prob.get(), opt.exportFile, opt.threads, states, edges))
+    {
+        perror(opt.exportFile.c_str());
+        return 1;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "exported %zu states and %zu edges to %s in %.3f s\n",
+            states, edges, opt.exportFile.c_str(), secs);
+    return 0;
+}
+
+// returns true if the actions lead from the problem's initial state to
+// its goal, each one offered by actions() where it is taken.
+static bool reachesGoal(Problem* p, const deque<Action>& path)
+{
+    State s = p->getInitial();
+    for(Action a : path)
+    {
+        deque<Action> acts = p->actions(s);
+        if(find(acts.begin(), acts.end(), a) == acts.end())
+            return false;
+        s = p->result(s, a);
+    }
+    return p->goal_test(s);
+}
+
+// runs the built-in checks: every engine against bfs, on solvable and
+// unsolvable instances, with and without a successor cache; malformed
+// batch input, varints, frames and compressed chunks; search limits; and
+// the bitstate sweep ending on an instance that once made it cycle.
+// prints each failed check on stderr and returns 1 if any failed.
+int runTests(const Options& base)
+{
+    // a hung check fails the run instead of stalling it
+    thread([]()
+    {
+        this_thread::sleep_for(chrono::minutes(5));
+        fprintf(stderr, "FAIL: the checks did not finish in 5 minutes\n");
+        _exit(1);
+    }).detach();
+
+    size_t checks = 0, failed = 0;
+    auto check = [&](bool ok, const string& what)
+    {
+        checks++;
+        if(!ok)
+        {
+            failed++;
+            fprintf(stderr, "FAIL: %s\n", what.c_str());
+        }
+    };
+
+    // engines: the same path length as bfs, or no path when bfs has none
+    struct CrossingCase
+    {
+        string name, items, eats;
+        int capacity;
+        bool symmetry;
+    };
+    const CrossingCase crossings[] = {
+        { "wolf, goat and cabbage", "wolf,goat,cabbage", "wolf:goat,goat:cabbage", 1, false },
+        { "16 items", "a*3,b*4,c*3,d,e,f,g,h", "a:c", 3, false },
+        { "16 items by symmetry", "a*3,b*4,c*3,d,e,f,g,h", "a:c", 3, true },
+        { "a cycle of eaters", "a,b,c", "a:b,b:c,c:a", 1, false },
+        { "7 items with no way over", "wolf*3,goat*2,cabbage*2", "wolf:goat,goat:cabbage", 2,
+          false },
+    };
+    vector<pair<string, shared_ptr<Problem>>> problems;
+    problems.push_back({ "the river puzzle", make_shared<BFSProblem>(RPCGW, PCGWR) });
+    // an unsafe goal: wolf and goat left alone together
+    problems.push_back({ "an unreachable river goal",
+                         make_shared<BFSProblem>(RPCGW, LW | LG | RP | RC) });
+    for(const CrossingCase& c : crossings)
+    {
+        Options opt = base;
+        opt.items = c.items;
+        opt.eats = c.eats;
+        opt.capacity = c.capacity;
+        opt.symmetry = c.symmetry;
+        problems.push_back({ c.name, shared_ptr<Problem>(makeCrossing(opt)) });
+    }
+    for(auto& [name, prob] : problems)
+    {
+        SearchStats st;
+        deque<Action> expected = BFS(prob.get(), &st);
+        bool solvable = prob->goal_test(prob->getInitial()) || !expected.empty();
+        for(bool cached : { false, true })
+        {
+            SuccessorCache graph(prob.get(), cached ? 1 << 16 : 0);
+            CachedProblem through(prob.get(), &graph, prob->getInitial(), prob->getGoal());
+            Problem* p = cached ? (Problem*)&through : prob.get();
+            for(const char* engine : ENGINES)
+            {
+                Options opt = base;
+                opt.engine = engine;
+                opt.threads = 2;
+                opt.hybrid.threshold = 0;
+                SearchStats run;
+                deque<Action> path = solve(p, opt, &run);
+                string what = string(engine) + (cached ? " through the successor cache" : "")
+                            + " on " + name;
+                if(solvable)
+                    check(path.size() == expected.size() && reachesGoal(prob.get(), path),
+                          what + " finds a path of " + to_string(expected.size()));
+                else
+                    check(path.empty() && run.status != Failed && run.status != OverBudget,
+                          what + " finds no path");
+            }
+        }
+    }
+
+    // search limits stop bfs and stepping alike, and a checkEvery of 0
+    // samples every expansion
+    {
+        BFSProblem river(RPCGW, PCGWR);
+        SearchLimits limits;
+        limits.maxExpanded = 3;
+        limits.checkEvery = 0;
+        SearchStats st;
+        check(BFS(&river, &st, limits).empty() && st.status == OverBudget && st.expanded == 3,
+              "bfs stops after --max-nodes expansions");
+        SteppingSearch search(&river, limits);
+        check(search.run() == OverBudget && search.stats().expanded == 3,
+              "stepping stops after --max-nodes expansions");
+        atomic<bool> cancel(true);
+        limits = SearchLimits();
+        limits.cancel = &cancel;
+        SearchStats stopped;
+        check(BFS(&river, &stopped, limits).empty() && stopped.status == Cancelled,
+              "bfs stops when cancelled");
+    }
+
+    // the batch reader takes well formed input and stops at bad input
+    struct ReaderCase
+    {
+        string input;
+        bool binary;
+        size_t instances;
+        string error;
+    };
+    const ReaderCase readerCases[] = {
+        { "15 240\n0x0a, 5 # comment\n", false, 2, "" },
+        { "15 240 abc 240# x", false, 1, "malformed number on line 1" },
+        { "0x 1", false, 0, "malformed number on line 1" },
+        { "1-2 3", false, 0, "malformed number on line 1" },
+        { "99999999999999999999 1", false, 0, "number too large for a state on line 1" },
+        { "18446744073709551615 1", false, 1, "" },
+        { "15 240\n15\n", false, 1, "instance without a goal on line 2" },
+        { string("\x0f\xf0\x01", 3), true, 1, "" },
+        { string("\x01\x01\x02", 3), true, 1, "instance without a goal at byte 2" },
+        { string("\x0f\x80", 2), true, 0, "truncated varint at byte 1" },
+        { string("\x01") + string(10, '\x80') + "\x01", true, 0,
+          "varint too large for a state at byte 1" },
+        { string("\x01") + string(9, '\xff') + "\x01", true, 1, "" },
+    };
+    for(const ReaderCase& c : readerCases)
+    {
+        FILE* in = fmemopen((void*)c.input.data(), c.input.size(), "rb");
+        InstanceReader reader(in, c.binary);
+        vector<Instance> batch;
+        size_t n = 0, got;
+        while((got = reader.read(batch, 4)) > 0)
+            n += got;
+        fclose(in);
+        check(n == c.instances && reader.error() == c.error,
+              "batch input \"" + c.input + "\" gives " + to_string(c.instances)
+              + " instances and \"" + c.error + "\", not " + to_string(n) + " and \""
+              + reader.error() + "\"");
+    }
+
+    // compressed chunks decode what was encoded, and reject corruption
+    {
+        vector<State> states;
+        for(State s = 0; states.size() < 3 * CompressedStates::CHUNK; s += 1 + s % 977)
+            states.push_back(s);
+        // a run of gaps too wide for 32 bits
+        for(State s = 1ull << 40; states.size() < 4 * CompressedStates::CHUNK; s += 1ull << 33)
+            states.push_back(s);
+        CompressedStates packed;
+        for(State s : states)
+            packed.push_back(s);
+        packed.finish();
+        vector<State> decoded;
+        packed.forEach([&decoded](State s) { decoded.push_back(s); return true; });
+        check(decoded == states, "compressed states decode to what was encoded");
+
+        const vector<uint8_t>& good = packed.encoded();
+        State out[CompressedStates::CHUNK];
+        auto decodes = [&out](vector<uint8_t> bytes)
+        {
+            const uint8_t* p = bytes.data();
+            size_t n = CompressedStates::decodeChunk(p, bytes.data() + bytes.size(), out);
+            return n == 0 && p == bytes.data() + bytes.size();
+        };
+        vector<uint8_t> bad = good;
+        for(size_t i = 0; i < (CompressedStates::CHUNK - 1 + 3) / 4; i++)
+            bad[CompressedStates::HEADER + i] = 0xFF;
+        check(decodes(bad), "a chunk whose control bytes overrun its payload is rejected");
+        // four gaps are one SSSE3 group: with the next chunk's bytes behind
+        // it, the whole load stays in the buffer but leaves the chunk
+        CompressedStates five;
+        for(State s = 1; s <= 5; s++)
+            five.push_back(s);
+        five.finish();
+        bad = five.encoded();
+        bad[CompressedStates::HEADER] = 0xFF;
+        bad.insert(bad.end(), 32, 0);
+        check(decodes(bad), "a chunk whose control bytes reach into the next chunk is rejected");
+        check(decodes(vector<uint8_t>(good.begin(), good.begin() + CompressedStates::HEADER - 1)),
+              "a cut chunk header is rejected");
+        check(decodes(vector<uint8_t>(good.begin(), good.begin() + CompressedStates::HEADER + 9)),
+              "a cut chunk payload is rejected");
+        bad = good;
+        bad[0] = bad[1] = 0;
+        check(decodes(bad), "a chunk of no states is rejected");
+        bad = good;
+        bad[0] = bad[1] = 0xFF;
+        check(decodes(bad), "a chunk of too many states is rejected");
+    }
+
+#ifdef __linux__
+    // daemon frames: a varint past 64 bits or a length over the limit is
+    // bad, a frame still arriving is not
+    {
+        unsigned long long v;
+        string bytes = string(9, '\xff') + "\x01";
+        const char* p = bytes.data();
+        check(takeVarint(p, p + bytes.size(), v) && v == ULLONG_MAX,
+              "a ten byte varint holds 64 bits");
+        bytes = string(9, '\xff') + "\x02";
+        p = bytes.data();
+        check(!takeVarint(p, p + bytes.size(), v), "a varint past 64 bits is rejected");
+
+        string payload;
+        size_t at = 0;
+        bool bad = false;
+        check(!takeFrame(string(10, '\xff'), at, payload, 1 << 20, bad) && bad,
+              "a frame length that is no varint is bad");
+        bad = false;
+        string frame;
+        appendVarint(frame, 2 << 20);
+        check(!takeFrame(frame, at, payload, 1 << 20, bad) && bad,
+              "a frame longer than the limit is bad");
+        bad = false;
+        frame.clear();
+        appendFrame(frame, "abc");
+        check(!takeFrame(frame.substr(0, 3), at, payload, 1 << 20, bad) && !bad,
+              "a frame still arriving is not bad");
+        check(takeFrame(frame, at, payload, 1 << 20, bad) && payload == "abc" && at == 4,
+              "a whole frame is taken");
+    }
+#endif
+
+    // the bitstate sweep ends even when false positives delay states
+    {
+        Options opt = base;
+        opt.items = "wolf*3,goat*2,cabbage*2,x*6";
+        opt.eats = "wolf:goat,goat:cabbage";
+        opt.capacity = 2;
+        unique_ptr<CrossingProblem> prob = makeCrossing(opt);
+        for(double bits : { 32.0, 8.0, 1.0 })
+            for(int k : { 1, 2 })
+            {
+                BitstateConfig cfg;
+                cfg.bitsPerState = bits;
+                cfg.hashes = k;
+                SearchStats st;
+                bitstateBFS(prob.get(), cfg, &st);
+                check(st.stored <= 2240, "bitstate with " + to_string(int(bits)) + " bits and "
+                      + to_string(k) + " hashes expands no state twice");
+            }
+    }
+
+    printf("%zu checks, %zu failed\n", checks, failed);
+    return failed ? 1 : 0;
+}
+
+// fills opt from the command line, returns false on a bad argument.
+bool parseOptions(int argc, char* argv[], Options& opt)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if(arg == "--batch")
+            opt.batch = true;
+        else if(arg == "--test")
+            opt.test = true;
+        else if(arg == "--binary")
+            opt.binaryIn = true;
+        else if(arg == "-i" && hasValue)
+            opt.input = argv[++i];
+        else if(arg == "-o" && hasValue)
+            opt.output = argv[++i];
+        else if(arg == "--format" && hasValue)
+            opt.format = argv[++i];
+        else if(arg == "--items" && hasValue)
+            opt.items = argv[++i];
+        else if(arg == "--eats" && hasValue)
+            opt.eats = argv[++i];
+        else if(arg == "--weights" && hasValue)
+            opt.weights = argv[++i];
+        else if(arg == "--capacity" && hasValue)
+            opt.capacity = atoi(argv[++i]);
+        else if(arg == "--symmetry")
+            opt.symmetry = true;
+        else if(arg == "--stats")
+            opt.stats = true;
+        else if(arg == "--count")
+            opt.count = true;
+        else if(arg == "--all")
+            opt.all = true;
+        else if(arg == "--engine" && hasValue && knownEngine(argv[i + 1]))
+            opt.engine = argv[++i];
+        else if(arg == "--temp-dir" && hasValue)
+            opt.hybrid.dir = opt.external.dir = argv[++i];
+        else if(arg == "--spill-at" && hasValue)
+            opt.hybrid.threshold = strtoull(argv[++i], nullptr, 10) << 20;
+        else if(arg == "--memory" && hasValue)
+            opt.external.memory = strtoull(argv[++i], nullptr, 10) << 20;
+        else if(arg == "--bench-sets" && hasValue)
+            opt.benchSets = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--bench-concurrent" && hasValue)
+            opt.benchConcurrent = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--bench-service" && hasValue)
+            opt.benchService = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--successor-cache" && hasValue)
+        {
+            opt.successors = true;
+            opt.successorBytes = strtoull(argv[++i], nullptr, 10) << 20;
+        }
+        else if(arg == "--materialize")
+            opt.successors = opt.materialize = true;
+        else if(arg == "--export" && hasValue)
+            opt.exportFile = argv[++i];
+        else if(arg == "--cache" && hasValue)
+            opt.cacheBytes = strtoull(argv[++i], nullptr, 10) << 20;
+        else if(arg == "--listen" && hasValue)
+            opt.listen = argv[++i];
+        else if(arg == "--load" && i + 2 < argc)
+        {
+            opt.connect = argv[++i];
+            opt.loadRequests = strtoull(argv[++i], nullptr, 10);
+        }
+        else if(arg == "--queue" && hasValue)
+            opt.queueSize = max(1ull, strtoull(argv[++i], nullptr, 10));
+        else if(arg == "--bloom-bits" && hasValue)
+            opt.bitstate.bitsPerState = max(1.0, atof(argv[++i]));
+        else if(arg == "--bloom-k" && hasValue)
+            opt.bitstate.hashes = max(1, atoi(argv[++i]));
+        else if(arg == "--max-nodes" && hasValue)
+            opt.limits.maxExpanded = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--max-depth" && hasValue)
+            opt.limits.maxDepth = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--timeout" && hasValue)
+            opt.timeout = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--tt-size" && hasValue)
+            opt.deepening.table = strtoull(argv[++i], nullptr, 10);
+        else if(arg == "--resume")
+            opt.external.resume = true;
+        else if(arg == "-j" && hasValue)
+            opt.external.threads = opt.threads = strtoul(argv[++i], nullptr, 10);
+        else if(arg == "--batch-size" && hasValue)
+            opt.batchSize = max(1ul, strtoul(argv[++i], nullptr, 10));
+        else
+            return false;
+    }
+    return true;
+}
+
+static void usage(const char* prog)
+{
+    fprintf(stderr,
+        "usage: %s [--batch [-i FILE] [-o FILE] [--binary] [-j THREADS]\n"
+        "           [--batch-size N] [--format codes|text|json|binary] [--cache MB]]\n"
+        "       %s --items ITEMS [--eats RULES] [--weights RULES] [--capacity N]\n"
+        "           [--symmetry] [--stats] [--count] [--all] [--engine ENGINE]\n"
+        "           [-j THREADS]"
+        " [--temp-dir DIR] [--memory MB] [--resume] [--spill-at MB]\n"
+        "           [--bloom-bits B] [--bloom-k K] [--tt-size N] [--max-nodes N]\n"
+        "           [--max-depth D] [--timeout MS] [--successor-cache MB]\n"
+        "           [--materialize]\n"
+        "       %s --bench-sets N\n"
+        "       %s --bench-concurrent N [-j MAX_THREADS]\n"
+        "       %s --bench-service N [-j THREADS] [--queue N] [--cache MB]\n"
+        "           [--items ITEMS ...]\n"
+        "       %s --listen ADDRESS [-j THREADS] [--cache MB]\n"
+        "       %s --load ADDRESS N [-j CONNECTIONS]\n"
+        "       %s --export FILE [-j THREADS] [--items ITEMS ...]\n"
+        "       %s --test\n"
+        "  without --batch, solves the peasant, wolf, goat and cabbage puzzle.\n"
+        "  --batch reads (initial, goal) pairs from FILE or stdin and writes\n"
+        "  one result per pair, in input order.\n"
+        "  --binary reads the pairs as LEB128 varints instead of text.\n"
+        "  --format selects the result encoding, \"codes\" by default.\n"
+        "  --cache keeps up to MB megabytes of solved paths to answer repeated\n"
+        "  requests, and requests from states along them, without searching.\n"
+        "  --items solves a generalized crossing, e.g. --items wolf,goat*2,cabbage\n"
+        "  --eats wolf:goat,goat:cabbage. --symmetry merges states that differ\n"
+        "  only in which of several same-named items is where. --weights\n"
+        "  goat:3,wolf:2 makes a crossing cost its heaviest passenger's weight\n"
+        "  (1 by default), honoured by astar and dijkstra.\n"
+        "  --count prints how many shortest solutions there are instead of one,\n"
+        "  --all prints every one of them.\n"
+        "  --engine picks bfs, ranked, packed, twobit, external, hybrid,\n"
+        "  parallel, bitstate, astar, dijkstra, iddfs, idastar, parallel-idastar\n"
+        "  or stepping. ranked searches over a dense numbering of the states,\n"
+        "  packed does too but keeps only a few bits per state, twobit only two\n"
+        "  bits and scans each level with -j threads. external keeps the levels\n"
+        "  in DIR, using about MB megabytes of memory; --resume continues an\n"
+        "  interrupted external search from its DIR. hybrid searches in memory\n"
+        "  but spills old levels to DIR past --spill-at megabytes. without\n"
+        "  --temp-dir both use a new private directory. parallel expands each\n"
+        "  level on -j threads. bitstate keeps finished levels as Bloom filters\n"
+        "  of B bits per state with K hashes, and may miss states. astar searches\n"
+        "  the states closest to the goal by a lower bound first, dijkstra the\n"
+        "  cheapest first. iddfs and idastar repeat depth first searches with a\n"
+        "  rising bound, using a transposition table of N slots (65536 by\n"
+        "  default); parallel-idastar splits each search over -j threads.\n"
+        "  stepping runs bfs a level at a time, reporting each level with\n"
+        "  --stats. bfs and stepping give up after --max-nodes expansions, past\n"
+        "  depth --max-depth or after --timeout milliseconds, and ^C cancels\n"
+        "  them; other engines refuse these limits.\n"
+        "  --successor-cache keeps the successors of expanded states in up to MB\n"
+        "  megabytes (0 for no limit) so no state is expanded twice, also with\n"
+        "  --batch and --bench-service; --materialize expands all states first.\n"
+        "  --bench-sets times N visited set inserts against std::unordered_set,\n"
+        "  --bench-concurrent N shared set inserts from 1 to 64 threads.\n"
+        "  --bench-service submits N searches to the asynchronous solver service\n"
+        "  and reports its throughput, queue depth and latency percentiles.\n"
+        "  --listen serves river crossing requests on unix:PATH or tcp:PORT\n"
+        "  (loopback) until ^C; --load sends N random requests to such a daemon\n"
+        "  over -j connections and checks the answers.\n"
+        "  --export writes every state reachable from the start, and the moves\n"
+        "  between them, to FILE as a binary compressed sparse row graph.\n"
+        "  --test runs the built-in checks of the engines and input decoders.\n",
+        prog, prog, prog, prog, prog, prog, prog, prog, prog);
+}
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if(!parseOptions(argc, argv, opt))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    // the limits bound the one search solve() runs
+    if(limited(opt) && (opt.batch || opt.benchSets || opt.benchConcurrent || opt.benchService
+                        || !opt.exportFile.empty() || !opt.listen.empty()
+                        || !opt.connect.empty() || opt.count || opt.all))
+    {
+        fprintf(stderr, "search limits only apply to a single search\n");
+        return 2;
+    }
+    if(opt.successors && (opt.benchSets || opt.benchConcurrent || !opt.exportFile.empty()
+                          || !opt.listen.empty() || !opt.connect.empty()))
+    {
+        fprintf(stderr, "--successor-cache only applies to searches, --batch and --bench-service\n");
+        return 2;
+    }
+    if(limited(opt) && opt.engine != "bfs" && opt.engine != "stepping")
+    {
+        fprintf(stderr, "search limits only apply to the bfs and stepping engines\n");
+        return 2;
+    }
+    if(opt.test)
+        return runTests(opt);
+    if(opt.benchSets)
+        return runSetBenchmark(opt.benchSets);
+    if(opt.benchConcurrent)
+        return runConcurrentBenchmark(opt.benchConcurrent, opt.threads ? opt.threads : 64);
+    if(opt.benchService)
+        return runServiceBenchmark(opt);
+    if(!opt.exportFile.empty())
+        return runExport(opt);
+    if(!opt.listen.empty() || !opt.connect.empty())
+    {
+#ifdef __linux__
+        return opt.listen.empty() ? runLoadClient(opt) : runDaemon(opt);
+#else
+        fprintf(stderr, "the solver daemon needs Linux\n");
+        return 1;
+#endif
+    }
+    if(opt.batch)
+        return runBatch(opt);
+    if(!opt.items.empty())
+        return runCrossing(opt);
+                                   //start, goal
+    BFSProblem* b = new BFSProblem(RPCGW, PCGWR);
+
+    // the engines search through the successor cache if asked to
+    unique_ptr<SuccessorCache> graph;
+    unique_ptr<CachedProblem> cached;
+    Problem* search = b;
+    if(opt.successors)
+    {
+        graph = make_unique<SuccessorCache>(b, opt.successorBytes);
+        if(opt.materialize)
+            graph->materialize(RPCGW);
+        cached = make_unique<CachedProblem>(b, graph.get(), RPCGW, PCGWR);
+        search = cached.get();
+    }
+
+    SearchStats st;
+    string text;
+    if(opt.all)
+    {
+        BufferedWriter out(stdout);
+        size_t n = 0;
+        for(const deque<Action>& solution : shortestSolutions(search))
+        {
+            text = "Solution " + to_string(++n) + ":\n";
+            TextEncoder(false).encode(text, { RPCGW, PCGWR }, solution, true);
+            out.write(text);
+        }
+        delete b;
+        return 0;
+    }
+    if(opt.count)
+        text = countText(search, &st);
+    else
+    {
+        deque<Action> solution = solve(search, opt, &st);
+
+        // translate the actions
+        TextEncoder(false).encode(text, { RPCGW, PCGWR }, solution, true);
+        text += stopText(st.status);
+    }
+    BufferedWriter(stdout).write(text);
+    if(opt.stats)
+    {
+        reportStats(st);
+        if(graph)
+            reportSuccessors(*graph);
+    }
 
+    cached.reset();
+    graph.reset();
     delete b;
 }